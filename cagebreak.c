@@ -33,35 +33,29 @@
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_screencopy_v1.h>
 #include <wlr/types/wlr_server_decoration.h>
-#if CG_HAS_XWAYLAND
-#include <wlr/types/wlr_xcursor_manager.h>
-#endif
 #include <wlr/types/wlr_xdg_decoration_v1.h>
 #include <wlr/types/wlr_xdg_output_v1.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/log.h>
-#if CG_HAS_XWAYLAND
-#include <wlr/xwayland.h>
-#endif
 
 #include "idle_inhibit_v1.h"
 #include "input_manager.h"
 #include "ipc_server.h"
 #include "keybinding.h"
+#include "latency.h"
 #include "message.h"
 #include "output.h"
 #include "parse.h"
+#include "process.h"
 #include "seat.h"
 #include "server.h"
+#include "snapshot.h"
+#include "watchdog.h"
 #include "xdg_shell.h"
 #if CG_HAS_XWAYLAND
 #include "xwayland.h"
 #endif
 
-#ifndef WAIT_ANY
-#define WAIT_ANY -1
-#endif
-
 bool show_info = false;
 
 void
@@ -106,13 +100,9 @@ handle_signal(int signal, void *const data) {
 	case SIGTERM:
 		display_terminate(server);
 		return 0;
-	case SIGALRM: {
-		struct cg_output *output;
-		wl_list_for_each(output, &server->outputs, link) {
-			message_clear(output);
-		}
+	case SIGCHLD:
+		process_reap_children();
 		return 0;
-	}
 	default:
 		return 0;
 	}
@@ -235,7 +225,7 @@ main(int argc, char *argv[]) {
 	struct wl_event_loop *event_loop = NULL;
 	struct wl_event_source *sigint_source = NULL;
 	struct wl_event_source *sigterm_source = NULL;
-	struct wl_event_source *sigalrm_source = NULL;
+	struct wl_event_source *sigchld_source = NULL;
 	struct wlr_backend *backend = NULL;
 	struct wlr_compositor *compositor = NULL;
 	struct wlr_data_device_manager *data_device_manager = NULL;
@@ -247,10 +237,6 @@ main(int argc, char *argv[]) {
 	struct wlr_xdg_output_manager_v1 *output_manager = NULL;
 	struct wlr_gamma_control_manager_v1 *gamma_control_manager = NULL;
 	struct wlr_xdg_shell *xdg_shell = NULL;
-#if CG_HAS_XWAYLAND
-	struct wlr_xwayland *xwayland = NULL;
-	struct wlr_xcursor_manager *xcursor_manager = NULL;
-#endif
 	int ret = 0;
 
 	if(!parse_args(&server, argc, argv)) {
@@ -266,12 +252,6 @@ main(int argc, char *argv[]) {
 	wl_list_init(&server.input_config);
 	wl_list_init(&server.output_config);
 
-	server.modes = malloc(4 * sizeof(char *));
-	if(!server.modes) {
-		wlr_log(WLR_ERROR, "Error allocating mode array");
-		return -1;
-	}
-
 	/* Wayland requires XDG_RUNTIME_DIR to be set. */
 	if(!getenv("XDG_RUNTIME_DIR")) {
 		wlr_log(WLR_ERROR, "XDG_RUNTIME_DIR is not set in the environment");
@@ -286,26 +266,28 @@ main(int argc, char *argv[]) {
 
 	server.running = true;
 
-	server.modes[0] = strdup("top");
-	server.modes[1] = strdup("root");
-	server.modes[2] = strdup("resize");
-	server.modes[3] = NULL;
-	if(server.modes[0] == NULL || server.modes[1] == NULL ||
-	   server.modes[2] == NULL) {
+	if(server_modes_init(&server) != 0) {
 		wlr_log(WLR_ERROR, "Error allocating default modes");
 		return 1;
 	}
+	server_pools_init(&server);
+	if(latency_init(&server) != 0 || watchdog_init(&server) != 0) {
+		return 1;
+	}
 
 	server.nws = 1;
 	server.message_timeout = 2;
+	server.message_coalesce = CG_MESSAGE_COALESCE_DROP;
+	server.sequence_timeout = 1000;
+	server.xwayland_idle_timeout = 0;
 
 	event_loop = wl_display_get_event_loop(server.wl_display);
 	sigint_source =
 	    wl_event_loop_add_signal(event_loop, SIGINT, handle_signal, &server);
 	sigterm_source =
 	    wl_event_loop_add_signal(event_loop, SIGTERM, handle_signal, &server);
-	sigalrm_source =
-	    wl_event_loop_add_signal(event_loop, SIGALRM, handle_signal, &server);
+	sigchld_source =
+	    wl_event_loop_add_signal(event_loop, SIGCHLD, handle_signal, &server);
 	server.event_loop = event_loop;
 
 	backend = wlr_backend_autocreate(server.wl_display);
@@ -321,13 +303,6 @@ main(int argc, char *argv[]) {
 		goto end;
 	}
 
-	server.keybindings = keybinding_list_init();
-	if(server.keybindings == NULL || server.keybindings->keybindings == NULL) {
-		wlr_log(WLR_ERROR, "Unable to allocate keybindings");
-		ret = 1;
-		goto end;
-	}
-
 	server.renderer = wlr_renderer_autocreate(backend);
 	if(!server.renderer) {
 		wlr_log(WLR_ERROR, "Unable to create the wlroots renderer");
@@ -472,41 +447,10 @@ main(int argc, char *argv[]) {
 	}
 
 #if CG_HAS_XWAYLAND
-	xwayland = wlr_xwayland_create(server.wl_display, compositor, true);
-	if(!xwayland) {
-		wlr_log(WLR_ERROR, "Cannot create XWayland server");
+	if(xwayland_init(&server, compositor) != 0) {
 		ret = 1;
 		goto end;
 	}
-	server.new_xwayland_surface.notify = handle_xwayland_surface_new;
-	wl_signal_add(&xwayland->events.new_surface, &server.new_xwayland_surface);
-
-	xcursor_manager = wlr_xcursor_manager_create(DEFAULT_XCURSOR, XCURSOR_SIZE);
-	if(!xcursor_manager) {
-		wlr_log(WLR_ERROR, "Cannot create XWayland XCursor manager");
-		ret = 1;
-		goto end;
-	}
-
-	if(setenv("DISPLAY", xwayland->display_name, true) < 0) {
-		wlr_log_errno(WLR_ERROR, "Unable to set DISPLAY for XWayland.",
-		              "Clients may not be able to connect");
-	} else {
-		wlr_log(WLR_DEBUG, "XWayland is running on display %s",
-		        xwayland->display_name);
-	}
-
-	if(!wlr_xcursor_manager_load(xcursor_manager, 1)) {
-		wlr_log(WLR_ERROR, "Cannot load XWayland XCursor theme");
-	}
-	struct wlr_xcursor *xcursor =
-	    wlr_xcursor_manager_get_xcursor(xcursor_manager, DEFAULT_XCURSOR, 1);
-	if(xcursor) {
-		struct wlr_xcursor_image *image = xcursor->images[0];
-		wlr_xwayland_set_cursor(xwayland, image->buffer, image->width * 4,
-		                        image->width, image->height, image->hotspot_x,
-		                        image->hotspot_y);
-	}
 #endif
 
 	const char *socket = wl_display_add_socket_auto(server.wl_display);
@@ -531,10 +475,6 @@ main(int argc, char *argv[]) {
 		        socket);
 	}
 
-#if CG_HAS_XWAYLAND
-	wlr_xwayland_set_seat(xwayland, server.seat->seat);
-#endif
-
 	if(show_info) {
 		char *msg = server_show_info(&server);
 		if(msg != NULL) {
@@ -546,6 +486,11 @@ main(int argc, char *argv[]) {
 		exit(0);
 	}
 
+	if(message_worker_init(&server) != 0) {
+		wlr_log(WLR_ERROR, "Failed to start message worker, messages will be "
+		                   "rendered on the main thread");
+	}
+
 	if(ipc_init(&server) != 0) {
 		wlr_log(WLR_ERROR, "Failed to initialize IPC");
 		ret = 1;
@@ -591,8 +536,7 @@ main(int argc, char *argv[]) {
 	wl_display_run(server.wl_display);
 
 #if CG_HAS_XWAYLAND
-	wlr_xwayland_destroy(xwayland);
-	wlr_xcursor_manager_destroy(xcursor_manager);
+	xwayland_fini(&server);
 #endif
 	wl_display_destroy_clients(server.wl_display);
 
@@ -601,10 +545,7 @@ end:
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-double-free"
 #endif
-	for(unsigned int i = 0; server.modes[i] != NULL; ++i) {
-		free(server.modes[i]);
-	}
-	free(server.modes);
+	server_modes_fini(&server);
 
 	struct cg_output_config *output_config, *output_config_tmp;
 	wl_list_for_each_safe(output_config, output_config_tmp,
@@ -614,16 +555,20 @@ end:
 		free(output_config);
 	}
 
-	keybinding_list_free(server.keybindings);
 	wl_event_source_remove(sigint_source);
 	wl_event_source_remove(sigterm_source);
-	wl_event_source_remove(sigalrm_source);
+	wl_event_source_remove(sigchld_source);
+	snapshot_fini(&server);
+	message_worker_fini(&server);
 
 	seat_destroy(server.seat);
 	/* This function is not null-safe, but we only ever get here
 	   with a proper wl_display. */
 	wl_display_destroy(server.wl_display);
 	wlr_output_layout_destroy(server.output_layout);
+	server_pools_fini(&server);
+	latency_fini(&server);
+	watchdog_fini(&server);
 
 	free(server.input);
 	pango_cairo_font_map_set_default(NULL);
@@ -0,0 +1,152 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _POSIX_C_SOURCE 200812L
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <wayland-server-core.h>
+
+#include "../ipc_server.h"
+#include "../server.h"
+#include "../util.h"
+
+#include "fuzz-lib.h"
+
+static void
+usage(FILE *file, const char *const cmd) {
+	fprintf(file,
+	        "Usage: %s [OPTIONS]\n"
+	        "\n"
+	        " -c <n>\t Write <n> bytes to the socket at once (default 4096)\n"
+	        " -h\t Display this help message\n"
+	        " -l <line>\t Send <line> repeatedly (default \"abort\")\n"
+	        " -s <n>\t Send <n> MiB in total (default 64)\n",
+	        cmd);
+}
+
+static bool
+parse_number(const char *str, long min, long max, long *value) {
+	char *end;
+	errno = 0;
+	*value = strtol(str, &end, 10);
+	return errno == 0 && end != str && *end == '\0' && *value >= min &&
+	       *value <= max;
+}
+
+/* Feeds lines through the IPC reader of a socketpair client in chunks of a
+ * fixed size, reporting how fast they are taken in */
+int
+main(int argc, char *argv[]) {
+	long chunk = 4096, mib = 64;
+	const char *line = "abort";
+
+	int c;
+	while((c = getopt(argc, argv, "c:hl:s:")) != -1) {
+		switch(c) {
+		case 'c':
+			if(!parse_number(optarg, 1, 1 << 20, &chunk)) {
+				fprintf(stderr, "Invalid chunk size\n");
+				return 1;
+			}
+			break;
+		case 'h':
+			usage(stdout, argv[0]);
+			return 0;
+		case 'l':
+			line = optarg;
+			break;
+		case 's':
+			if(!parse_number(optarg, 1, 4096, &mib)) {
+				fprintf(stderr, "Invalid size\n");
+				return 1;
+			}
+			break;
+		default:
+			usage(stderr, argv[0]);
+			return 1;
+		}
+	}
+	if(optind < argc || strchr(line, '\n') != NULL) {
+		usage(stderr, argv[0]);
+		return 1;
+	}
+
+	/* Build enough whole lines to fill a chunk */
+	size_t line_length = strlen(line) + 1;
+	size_t lines_per_chunk = ((size_t)chunk + line_length - 1) / line_length;
+	size_t buffer_size = lines_per_chunk * line_length;
+	char *buffer = malloc(buffer_size);
+	if(!buffer) {
+		fprintf(stderr, "Unable to allocate the line buffer\n");
+		return 1;
+	}
+	for(size_t i = 0; i < lines_per_chunk; ++i) {
+		memcpy(buffer + i * line_length, line, line_length - 1);
+		buffer[(i + 1) * line_length - 1] = '\n';
+	}
+
+	char *init_argv[] = {argv[0], NULL};
+	char **init_argv_ptr = init_argv;
+	int init_argc = 1;
+	optind = 1;
+	if(LLVMFuzzerInitialize(&init_argc, &init_argv_ptr) != 0) {
+		free(buffer);
+		return 1;
+	}
+
+	int peer_fd;
+	struct cg_ipc_client *client = ipc_fuzz_connect(&server, &peer_fd);
+	if(!client) {
+		free(buffer);
+		return 1;
+	}
+
+	size_t total = (size_t)mib << 20;
+	size_t sent = 0, offset = 0;
+	uint64_t start = monotonic_ns();
+	while(sent < total) {
+		size_t length = (size_t)chunk;
+		if(length > total - sent) {
+			length = total - sent;
+		}
+		/* Chunks need not end on a line boundary, so wrap around the
+		 * buffer of whole lines */
+		while(length > 0) {
+			size_t part = buffer_size - offset;
+			if(part > length) {
+				part = length;
+			}
+			if(!ipc_fuzz_feed(&server, client, peer_fd,
+			                  (uint8_t *)buffer + offset, part)) {
+				fprintf(stderr, "IPC client was disconnected\n");
+				close(peer_fd);
+				free(buffer);
+				return 1;
+			}
+			offset = (offset + part) % buffer_size;
+			sent += part;
+			length -= part;
+		}
+	}
+	uint64_t elapsed = monotonic_ns() - start;
+
+	double seconds = (double)elapsed / 1e9;
+	printf("%zu bytes in chunks of %ld: %.3f s, %.1f MiB/s, %.0f lines/s\n",
+	       sent, chunk, seconds, (double)sent / (1 << 20) / seconds,
+	       (double)(sent / line_length) / seconds);
+
+	ipc_fuzz_close(&server, client, peer_fd);
+	free(buffer);
+	return 0;
+}
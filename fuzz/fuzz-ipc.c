@@ -0,0 +1,52 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _POSIX_C_SOURCE 200812L
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <wayland-server-core.h>
+
+#include "../ipc_server.h"
+#include "../server.h"
+
+#include "fuzz-lib.h"
+
+/* The input is a sequence of chunks, each a length byte followed by up to
+ * that many plus one bytes which are written to the IPC socket at once.
+ * This way the fuzzer controls where reads split lines and requests. */
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if(size == 0) {
+		return 0;
+	}
+	int peer_fd;
+	struct cg_ipc_client *client = ipc_fuzz_connect(&server, &peer_fd);
+	if(!client) {
+		abort();
+	}
+	server.running = true;
+
+	size_t offset = 0;
+	while(offset < size) {
+		size_t length = (size_t)data[offset++] + 1;
+		if(length > size - offset) {
+			length = size - offset;
+		}
+		if(!ipc_fuzz_feed(&server, client, peer_fd, data + offset, length)) {
+			client = NULL;
+			break;
+		}
+		offset += length;
+	}
+
+	ipc_fuzz_close(&server, client, peer_fd);
+	reset_state(&server);
+	return 0;
+}
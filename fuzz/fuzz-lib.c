@@ -10,11 +10,14 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -37,24 +40,22 @@
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_screencopy_v1.h>
 #include <wlr/types/wlr_server_decoration.h>
-#if CG_HAS_XWAYLAND
-#include <wlr/types/wlr_xcursor_manager.h>
-#endif
 #include <wlr/types/wlr_xdg_decoration_v1.h>
 #include <wlr/types/wlr_xdg_output_v1.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/log.h>
-#if CG_HAS_XWAYLAND
-#include <wlr/xwayland.h>
-#endif
 
 #include "../idle_inhibit_v1.h"
 #include "../input_manager.h"
+#include "../ipc_server.h"
 #include "../keybinding.h"
+#include "../latency.h"
+#include "../message.h"
 #include "../output.h"
 #include "../parse.h"
 #include "../seat.h"
 #include "../server.h"
+#include "../watchdog.h"
 #include "../xdg_shell.h"
 #if CG_HAS_XWAYLAND
 #include "../xwayland.h"
@@ -65,11 +66,6 @@
 struct cg_server server;
 struct wlr_xdg_shell *xdg_shell;
 
-struct wlr_xwayland *xwayland;
-#if CG_HAS_XWAYLAND
-struct wlr_xcursor_manager *xcursor_manager;
-#endif
-
 static bool
 drop_permissions(void) {
 	if(getuid() != geteuid() || getgid() != getegid()) {
@@ -101,27 +97,20 @@ void
 cleanup() {
 	server.running = false;
 #if CG_HAS_XWAYLAND
-	if(xwayland != NULL) {
-		wlr_xwayland_destroy(xwayland);
-	}
-	if(xcursor_manager != NULL) {
-		wlr_xcursor_manager_destroy(xcursor_manager);
-	}
+	xwayland_fini(&server);
 #endif
 	wl_display_destroy_clients(server.wl_display);
 
-	for(unsigned int i = 0; server.modes[i] != NULL; ++i) {
-		free(server.modes[i]);
-	}
-	free(server.modes);
-
-	keybinding_list_free(server.keybindings);
+	server_modes_fini(&server);
 
 	seat_destroy(server.seat);
 	/* This function is not null-safe, but we only ever get here
 	   with a proper wl_display. */
 	wl_display_destroy(server.wl_display);
 	wlr_output_layout_destroy(server.output_layout);
+	server_pools_fini(&server);
+	latency_fini(&server);
+	watchdog_fini(&server);
 }
 
 int
@@ -165,18 +154,30 @@ LLVMFuzzerInitialize(int *argc, char ***argv) {
 
 	server.running = true;
 
-	server.modes = malloc(4 * sizeof(char *));
-	server.modes[0] = strdup("top");
-	server.modes[1] = strdup("root");
-	server.modes[2] = strdup("resize");
-	server.modes[3] = NULL;
+	if(server_modes_init(&server) != 0) {
+		wlr_log(WLR_ERROR, "Error allocating default modes");
+		return 1;
+	}
+	server_pools_init(&server);
+	if(latency_init(&server) != 0 || watchdog_init(&server) != 0) {
+		return 1;
+	}
 
 	server.nws = 1;
 	server.message_timeout = 2;
+	server.message_coalesce = CG_MESSAGE_COALESCE_DROP;
+	server.sequence_timeout = 1000;
+	server.xwayland_idle_timeout = 0;
 
 	event_loop = wl_display_get_event_loop(server.wl_display);
 	server.event_loop = event_loop;
 
+	/* No IPC socket is bound, clients are fed through socketpairs by
+	 * ipc_fuzz_connect */
+	wl_list_init(&server.ipc.client_list);
+	server.ipc.current_client = NULL;
+	server.ipc.resume_timer = NULL;
+
 	backend = wlr_multi_backend_create(server.wl_display);
 	if(!backend) {
 		wlr_log(WLR_ERROR, "Unable to create the wlroots multi backend");
@@ -206,13 +207,6 @@ LLVMFuzzerInitialize(int *argc, char ***argv) {
 		goto end;
 	}
 
-	server.keybindings = keybinding_list_init();
-	if(server.keybindings == NULL || server.keybindings->keybindings == NULL) {
-		wlr_log(WLR_ERROR, "Unable to allocate keybindings");
-		ret = 1;
-		goto end;
-	}
-
 	wl_list_init(&server.output_config);
 
 	server.renderer = wlr_renderer_autocreate(backend);
@@ -363,42 +357,10 @@ LLVMFuzzerInitialize(int *argc, char ***argv) {
 	}
 
 #if CG_HAS_XWAYLAND
-	xwayland = wlr_xwayland_create(server.wl_display, compositor, true);
-	if(!xwayland) {
-		wlr_log(WLR_ERROR, "Cannot create XWayland server");
-		ret = 1;
-		goto end;
-	}
-	server.new_xwayland_surface.notify = handle_xwayland_surface_new;
-	wl_signal_add(&xwayland->events.new_surface, &server.new_xwayland_surface);
-
-	xcursor_manager = wlr_xcursor_manager_create(DEFAULT_XCURSOR, XCURSOR_SIZE);
-	if(!xcursor_manager) {
-		wlr_log(WLR_ERROR, "Cannot create XWayland XCursor manager");
+	if(xwayland_init(&server, compositor) != 0) {
 		ret = 1;
 		goto end;
 	}
-
-	if(setenv("DISPLAY", xwayland->display_name, true) < 0) {
-		wlr_log_errno(WLR_ERROR, "Unable to set DISPLAY for XWayland.",
-		              "Clients may not be able to connect");
-	} else {
-		wlr_log(WLR_DEBUG, "XWayland is running on display %s",
-		        xwayland->display_name);
-	}
-
-	if(wlr_xcursor_manager_load(xcursor_manager, 1)) {
-		wlr_log(WLR_ERROR, "Cannot load XWayland XCursor theme");
-	}
-	struct wlr_xcursor *xcursor =
-	    wlr_xcursor_manager_get_xcursor(xcursor_manager, DEFAULT_XCURSOR, 1);
-	if(xcursor) {
-		struct wlr_xcursor_image *image = xcursor->images[0];
-		wlr_xwayland_set_cursor(xwayland, image->buffer, image->width * 4,
-		                        image->width, image->height, image->hotspot_x,
-		                        image->hotspot_y);
-	}
-
 #endif
 
 	const char *socket = wl_display_add_socket_auto(server.wl_display);
@@ -573,3 +535,128 @@ destroy_output(char *line, struct cg_server *server) {
 	}
 	it->damage_destroy.notify(&it->damage_destroy, NULL);
 }
+
+/* Undoes what the commands of the last input changed */
+void
+reset_state(struct cg_server *server) {
+	run_action(KEYBINDING_WORKSPACES, server,
+	           (union keybinding_params){.i = 1});
+	run_action(KEYBINDING_LAYOUT_FULLSCREEN, server,
+	           (union keybinding_params){.c = NULL});
+	struct cg_output *output;
+	wl_list_for_each(output, &server->outputs, link) { message_clear(output); }
+	server_modes_fini(server);
+	server_modes_init(server);
+
+	struct cg_output_config *output_config, *output_config_tmp;
+	wl_list_for_each_safe(output_config, output_config_tmp,
+	                      &server->output_config, link) {
+		wl_list_remove(&output_config->link);
+		free(output_config->output_name);
+		free(output_config);
+	}
+}
+
+/* Connects an IPC client to one end of a socketpair, the other end is
+ * returned in peer_fd */
+struct cg_ipc_client *
+ipc_fuzz_connect(struct cg_server *server, int *peer_fd) {
+	int fds[2];
+	if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+	              fds) != 0) {
+		wlr_log_errno(WLR_ERROR, "Unable to create IPC socketpair");
+		return NULL;
+	}
+	struct cg_ipc_client *client = ipc_client_create(server, fds[0]);
+	if(!client) {
+		close(fds[0]);
+		close(fds[1]);
+		return NULL;
+	}
+	*peer_fd = fds[1];
+	return client;
+}
+
+/* Reads and drops the replies sent to peer_fd, closing the file
+ * descriptors which came along */
+static void
+ipc_fuzz_drain(int peer_fd) {
+	char buffer[4096];
+	char control[CMSG_SPACE(sizeof(int))];
+	for(;;) {
+		struct iovec iov = {.iov_base = buffer, .iov_len = sizeof(buffer)};
+		struct msghdr msg = {
+		    .msg_iov = &iov,
+		    .msg_iovlen = 1,
+		    .msg_control = control,
+		    .msg_controllen = sizeof(control),
+		};
+		if(recvmsg(peer_fd, &msg, MSG_CMSG_CLOEXEC) <= 0) {
+			return;
+		}
+		for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+		    cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if(cmsg->cmsg_level == SOL_SOCKET &&
+			   cmsg->cmsg_type == SCM_RIGHTS) {
+				int fd;
+				memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+				close(fd);
+			}
+		}
+	}
+}
+
+/* Writes data to peer_fd and dispatches the IPC handlers of client the way
+ * the event loop would, until everything written was handled. Returns false
+ * if client was disconnected, in which case it was freed. */
+bool
+ipc_fuzz_feed(struct cg_server *server, struct cg_ipc_client *client,
+              int peer_fd, const uint8_t *data, size_t size) {
+	size_t written = 0;
+	for(;;) {
+		if(written < size) {
+			ssize_t ret =
+			    send(peer_fd, data + written, size - written, MSG_NOSIGNAL);
+			if(ret > 0) {
+				written += ret;
+			} else if(ret == -1 && errno != EAGAIN && errno != EINTR) {
+				wlr_log_errno(WLR_ERROR, "Unable to write to IPC socketpair");
+				return false;
+			}
+		}
+
+		int available = 0;
+		if(ioctl(client->fd, FIONREAD, &available) < 0) {
+			return false;
+		}
+		/* Readable is not polled while commands are pending */
+		if(client->pending) {
+			ipc_handle_resume(server);
+		} else if(available > 0) {
+			ipc_client_handle_readable(client->fd, WL_EVENT_READABLE,
+			                           client);
+		} else if(written == size) {
+			return true;
+		}
+		if(wl_list_empty(&server->ipc.client_list)) {
+			return false;
+		}
+
+		if(client->write_buffer_len > 0) {
+			ipc_client_handle_writable(client->fd, WL_EVENT_WRITABLE, client);
+			if(wl_list_empty(&server->ipc.client_list)) {
+				return false;
+			}
+		}
+		ipc_fuzz_drain(peer_fd);
+	}
+}
+
+void
+ipc_fuzz_close(struct cg_server *server, struct cg_ipc_client *client,
+               int peer_fd) {
+	if(client != NULL && !wl_list_empty(&server->ipc.client_list)) {
+		ipc_client_disconnect(client);
+	}
+	close(peer_fd);
+}
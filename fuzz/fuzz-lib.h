@@ -11,6 +11,11 @@
 
 #define _POSIX_C_SOURCE 200812L
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../ipc_server.h"
 #include "../server.h"
 
 #ifndef WAIT_ANY
@@ -46,4 +51,18 @@ destroy_input_device(char *line, struct cg_server *server);
 void
 destroy_output(char *line, struct cg_server *server);
 
+void
+reset_state(struct cg_server *server);
+
+struct cg_ipc_client *
+ipc_fuzz_connect(struct cg_server *server, int *peer_fd);
+
+bool
+ipc_fuzz_feed(struct cg_server *server, struct cg_ipc_client *client,
+              int peer_fd, const uint8_t *data, size_t size);
+
+void
+ipc_fuzz_close(struct cg_server *server, struct cg_ipc_client *client,
+               int peer_fd);
+
 #endif
@@ -62,26 +62,6 @@ LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	str[max_line_size - 1] = 0;
 	set_configuration(&server, str);
 	free(str);
-	keybinding_list_free(server.keybindings);
-	server.keybindings = keybinding_list_init();
-	run_action(KEYBINDING_WORKSPACES, &server,
-	           (union keybinding_params){.i = 1});
-	run_action(KEYBINDING_LAYOUT_FULLSCREEN, &server,
-	           (union keybinding_params){.c = NULL});
-	struct cg_output *output;
-	wl_list_for_each(output, &server.outputs, link) { message_clear(output); }
-	for(unsigned int i = 3; server.modes[i] != NULL; ++i) {
-		free(server.modes[i]);
-	}
-	server.modes[3] = NULL;
-	server.modes = realloc(server.modes, 4 * sizeof(char *));
-
-	struct cg_output_config *output_config, *output_config_tmp;
-	wl_list_for_each_safe(output_config, output_config_tmp,
-	                      &server.output_config, link) {
-		wl_list_remove(&output_config->link);
-		free(output_config->output_name);
-		free(output_config);
-	}
+	reset_state(&server);
 	return 0;
 }
@@ -0,0 +1,30 @@
+#ifndef CG_IPC_PROTOCOL_H
+#define CG_IPC_PROTOCOL_H
+
+#include <stdint.h>
+
+/* Clients which start by sending IPC_FRAMED_MAGIC send each request as a
+ * struct cg_ipc_request followed by length bytes of command. Every request
+ * gets a struct cg_ipc_reply followed by length bytes of output, or of the
+ * error message if the command failed. Replies are sent in the order of
+ * the requests, which may be pipelined. Fields are in host byte order. */
+#define IPC_FRAMED_MAGIC "\0CGF"
+#define IPC_FRAMED_MAGIC_SIZE 4
+
+struct cg_ipc_request {
+	uint32_t length;
+	uint32_t id; // Chosen by the client and copied to the reply
+};
+
+enum cg_ipc_status {
+	CG_IPC_STATUS_OK = 0,
+	CG_IPC_STATUS_ERROR = 1,
+};
+
+struct cg_ipc_reply {
+	uint32_t length;
+	uint32_t id;
+	uint32_t status; // enum cg_ipc_status
+};
+
+#endif
@@ -7,15 +7,20 @@
  * See the LICENSE file accompanying this file.
  */
 
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE // accept4
 
 #include "ipc_server.h"
 #include "message.h"
 #include "parse.h"
 #include "server.h"
+#include "trace.h"
+#include "watchdog.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -28,6 +33,9 @@ handle_display_destroy(struct wl_listener *listener, void *data) {
 	if(ipc->event_source != NULL) {
 		wl_event_source_remove(ipc->event_source);
 	}
+	if(ipc->resume_timer != NULL) {
+		wl_event_source_remove(ipc->resume_timer);
+	}
 	close(ipc->socket);
 	unlink(ipc->sockaddr->sun_path);
 
@@ -90,7 +98,7 @@ ipc_init(struct cg_server *server) {
 		return -1;
 	}
 
-	if(listen(ipc->socket, 3) == -1) {
+	if(listen(ipc->socket, IPC_LISTEN_BACKLOG) == -1) {
 		wlr_log(WLR_ERROR, "Unable to listen on IPC socket");
 		free(ipc->sockaddr);
 		return -1;
@@ -99,6 +107,7 @@ ipc_init(struct cg_server *server) {
 	setenv("CAGEBREAK_SOCKET", ipc->sockaddr->sun_path, 1);
 
 	wl_list_init(&ipc->client_list);
+	ipc->current_client = NULL;
 
 	ipc->display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(server->wl_display, &ipc->display_destroy);
@@ -106,9 +115,48 @@ ipc_init(struct cg_server *server) {
 	ipc->event_source =
 	    wl_event_loop_add_fd(server->event_loop, ipc->socket, WL_EVENT_READABLE,
 	                         ipc_handle_connection, server);
+	ipc->resume_timer =
+	    wl_event_loop_add_timer(server->event_loop, ipc_handle_resume, server);
 	return 0;
 }
 
+/* Adds a client reading from client_fd, which it takes ownership of on
+ * success. Also used by the fuzzers to feed a socketpair. */
+struct cg_ipc_client *
+ipc_client_create(struct cg_server *server, int client_fd) {
+	struct cg_ipc_client *client = calloc(1, sizeof(struct cg_ipc_client));
+	if(!client) {
+		wlr_log(WLR_ERROR, "Unable to allocate ipc client");
+		return NULL;
+	}
+	client->server = server;
+	client->fd = client_fd;
+	client->reply_fd = -1;
+	client->read_buf_size = IPC_INITIAL_BUFFER_SIZE;
+	client->read_buffer = malloc(client->read_buf_size);
+	client->write_buffer_size = IPC_INITIAL_BUFFER_SIZE;
+	client->write_buffer = malloc(client->write_buffer_size);
+	if(!client->read_buffer || !client->write_buffer) {
+		wlr_log(WLR_ERROR, "Unable to allocate ipc client buffers");
+		free(client->read_buffer);
+		free(client->write_buffer);
+		free(client);
+		return NULL;
+	}
+	client->event_source =
+	    wl_event_loop_add_fd(server->event_loop, client_fd, WL_EVENT_READABLE,
+	                         ipc_client_handle_readable, client);
+	if(!client->event_source) {
+		wlr_log(WLR_ERROR, "Unable to add ipc client to the event loop");
+		free(client->read_buffer);
+		free(client->write_buffer);
+		free(client);
+		return NULL;
+	}
+	wl_list_insert(&server->ipc.client_list, &client->link);
+	return client;
+}
+
 int
 ipc_handle_connection(int fd, uint32_t mask, void *data) {
 	(void)fd;
@@ -119,58 +167,193 @@ ipc_handle_connection(int fd, uint32_t mask, void *data) {
 		return 0;
 	}
 
-	int client_fd = accept(ipc->socket, NULL, NULL);
-	if(client_fd == -1) {
-		wlr_log(WLR_ERROR, "Unable to accept IPC client connection");
-		return 0;
+	/* Take all pending connections, clients which reconnect often tend to
+	 * arrive in bursts */
+	for(;;) {
+		int client_fd = accept4(ipc->socket, NULL, NULL,
+		                        SOCK_CLOEXEC | SOCK_NONBLOCK);
+		if(client_fd == -1) {
+			if(errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			if(errno != EAGAIN && errno != EWOULDBLOCK) {
+				wlr_log_errno(WLR_ERROR,
+				              "Unable to accept IPC client connection");
+			}
+			return 0;
+		}
+
+		if(!ipc_client_create(server, client_fd)) {
+			close(client_fd);
+			return 0;
+		}
 	}
+}
 
-	int flags;
-	if((flags = fcntl(client_fd, F_GETFD)) == -1 ||
-	   fcntl(client_fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
-		wlr_log(WLR_ERROR, "Unable to set CLOEXEC on IPC client socket");
-		close(client_fd);
+/* Appends the data available on the socket of client to its read buffer.
+ * Returns the number of bytes read, 0 at the end of the stream and -1 if the
+ * client was disconnected. */
+static ssize_t
+ipc_client_read(struct cg_ipc_client *client) {
+	int read_available;
+	if(ioctl(client->fd, FIONREAD, &read_available) < 0) {
+		wlr_log(WLR_ERROR, "Unable to read IPC socket buffer size");
+		ipc_client_disconnect(client);
+		return -1;
+	}
+	if(read_available == 0) {
 		return 0;
 	}
-	if((flags = fcntl(client_fd, F_GETFL)) == -1 ||
-	   fcntl(client_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-		wlr_log(WLR_ERROR, "Unable to set NONBLOCK on IPC client socket");
-		close(client_fd);
+
+	/* Grow the buffer to take all available data, keeping room for \0 */
+	size_t needed = client->read_buf_len + (size_t)read_available + 1;
+	if(needed > IPC_MAX_READ_BUFFER_SIZE) {
+		needed = IPC_MAX_READ_BUFFER_SIZE;
+	}
+	if(needed > client->read_buf_size) {
+		size_t size = client->read_buf_size;
+		while(size < needed) {
+			size *= 2;
+		}
+		if(size > IPC_MAX_READ_BUFFER_SIZE) {
+			size = IPC_MAX_READ_BUFFER_SIZE;
+		}
+		char *new_buffer = realloc(client->read_buffer, size);
+		if(!new_buffer) {
+			wlr_log(WLR_ERROR, "Unable to reallocate ipc client read buffer");
+			ipc_client_disconnect(client);
+			return -1;
+		}
+		client->read_buffer = new_buffer;
+		client->read_buf_size = size;
+	}
+
+	size_t read_size = client->read_buf_size - 1 - client->read_buf_len;
+	if(read_size > (size_t)read_available) {
+		read_size = read_available;
+	}
+	// Append to buffer
+	ssize_t received = recv(
+	    client->fd, client->read_buffer + client->read_buf_len, read_size, 0);
+	if(received == -1) {
+		wlr_log(WLR_ERROR, "Unable to receive data from IPC client");
+		ipc_client_disconnect(client);
+		return -1;
+	}
+	client->read_buf_len += received;
+	return received;
+}
+
+/* Runs the commands client sent before it hung up, reading the rest of them
+ * from its socket. Once all ran, the client is removed as soon as its replies
+ * are sent. Continued from the resume timer if the budget runs out. */
+static void
+ipc_client_drain(struct cg_ipc_client *client) {
+	for(;;) {
+		if(!ipc_client_handle_command(client) || client->pending) {
+			return;
+		}
+		ssize_t received = ipc_client_read(client);
+		if(received < 0) {
+			return;
+		}
+		if(received == 0) {
+			break;
+		}
+	}
+	if(client->write_buffer_len == 0) {
+		ipc_client_disconnect(client);
+	}
+}
+
+/* Stops polling a client which closed its end of the socket, which the event
+ * loop would report over and over again, and runs what it sent */
+static void
+ipc_client_hangup(struct cg_ipc_client *client) {
+	if(client->hangup) {
+		return;
+	}
+	client->hangup = true;
+	wl_event_source_remove(client->event_source);
+	client->event_source = NULL;
+	ipc_client_drain(client);
+}
+
+int
+ipc_client_handle_readable(int client_fd, uint32_t mask, void *data) {
+	(void)client_fd;
+	struct cg_ipc_client *client = data;
+
+	if(mask & WL_EVENT_ERROR) {
+		wlr_log(WLR_ERROR, "IPC Client socket error, removing client");
+		ipc_client_disconnect(client);
 		return 0;
 	}
 
-	struct cg_ipc_client *client = malloc(sizeof(struct cg_ipc_client));
-	if(!client) {
-		wlr_log(WLR_ERROR, "Unable to allocate ipc client");
-		close(client_fd);
+	if(mask & WL_EVENT_HANGUP) {
+		ipc_client_hangup(client);
 		return 0;
 	}
-	// +1 for \n and +1 for \0
-	client->read_buffer = malloc(sizeof(char) * (MAX_LINE_SIZE + 2));
-	client->read_buf_len = 0;
-	client->read_discard = 0;
-	client->server = server;
-	client->fd = client_fd;
-	client->event_source =
-	    wl_event_loop_add_fd(server->event_loop, client_fd, WL_EVENT_READABLE,
-	                         ipc_client_handle_readable, client);
-	client->writable_event_source = NULL;
 
-	client->write_buffer_size = 128;
-	client->write_buffer_len = 0;
-	client->write_buffer = malloc(client->write_buffer_size);
-	if(!client->write_buffer) {
-		wlr_log(WLR_ERROR, "Unable to allocate ipc client write buffer");
-		close(client_fd);
+	ssize_t received = ipc_client_read(client);
+	if(received < 0) {
+		return 0;
+	}
+	if(received == 0) {
+		/* The client shut down its end for writing */
+		ipc_client_hangup(client);
 		return 0;
 	}
 
-	wl_list_insert(&ipc->client_list, &client->link);
+	ipc_client_handle_command(client);
 	return 0;
 }
 
+/* Returns an empty buffer which grew for a large message to its initial
+ * size */
+static void
+ipc_buffer_shrink(char **buffer, size_t *size) {
+	if(*size <= IPC_INITIAL_BUFFER_SIZE) {
+		return;
+	}
+	char *new_buffer = realloc(*buffer, IPC_INITIAL_BUFFER_SIZE);
+	if(new_buffer) {
+		*buffer = new_buffer;
+		*size = IPC_INITIAL_BUFFER_SIZE;
+	}
+}
+
+/* Sends the write buffer of client with reply_fd attached to its first
+ * byte, closing reply_fd once it is on its way */
+static ssize_t
+ipc_client_send_fd(struct cg_ipc_client *client) {
+	char control[CMSG_SPACE(sizeof(int))] = {0};
+	struct iovec iov = {
+	    .iov_base = client->write_buffer,
+	    .iov_len = client->write_buffer_len,
+	};
+	struct msghdr msg = {
+	    .msg_iov = &iov,
+	    .msg_iovlen = 1,
+	    .msg_control = control,
+	    .msg_controllen = sizeof(control),
+	};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &client->reply_fd, sizeof(int));
+
+	ssize_t written = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+	if(written > 0) {
+		close(client->reply_fd);
+		client->reply_fd = -1;
+	}
+	return written;
+}
+
 int
-ipc_client_handle_readable(int client_fd, uint32_t mask, void *data) {
+ipc_client_handle_writable(int client_fd, uint32_t mask, void *data) {
 	struct cg_ipc_client *client = data;
 
 	if(mask & WL_EVENT_ERROR) {
@@ -180,35 +363,160 @@ ipc_client_handle_readable(int client_fd, uint32_t mask, void *data) {
 	}
 
 	if(mask & WL_EVENT_HANGUP) {
-		ipc_client_disconnect(client);
+		/* The replies cannot be delivered anymore, but the commands the
+		 * client sent before are still run */
+		wl_event_source_remove(client->writable_event_source);
+		client->writable_event_source = NULL;
+		client->write_buffer_len = 0;
+		if(client->reply_fd != -1) {
+			close(client->reply_fd);
+			client->reply_fd = -1;
+		}
+		if(client->hangup) {
+			if(!client->pending) {
+				ipc_client_disconnect(client);
+			}
+		} else {
+			ipc_client_hangup(client);
+		}
 		return 0;
 	}
 
-	int read_available;
-	if(ioctl(client_fd, FIONREAD, &read_available) < 0) {
-		wlr_log(WLR_ERROR, "Unable to read IPC socket buffer size");
+	ssize_t written;
+	if(client->reply_fd != -1 && client->reply_fd_offset == 0) {
+		written = ipc_client_send_fd(client);
+	} else {
+		/* Stop before the byte the file descriptor goes with */
+		size_t length = client->reply_fd != -1 ? client->reply_fd_offset
+		                                       : client->write_buffer_len;
+		written = send(client_fd, client->write_buffer, length, MSG_NOSIGNAL);
+		if(written > 0 && client->reply_fd != -1) {
+			client->reply_fd_offset -= written;
+		}
+	}
+	if(written == -1) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return 0;
+		}
+		wlr_log(WLR_ERROR, "Unable to send data to IPC client");
 		ipc_client_disconnect(client);
 		return 0;
 	}
 
-	int read_size = read_available < MAX_LINE_SIZE + 1 - client->read_buf_len
-	                    ? read_available
-	                    : MAX_LINE_SIZE + 1 - client->read_buf_len;
-	// Append to buffer
-	ssize_t received = recv(
-	    client_fd, client->read_buffer + client->read_buf_len, read_size, 0);
-	if(received == -1) {
-		wlr_log(WLR_ERROR, "Unable to receive data from IPC client");
-		ipc_client_disconnect(client);
-		return 0;
+	memmove(client->write_buffer, client->write_buffer + written,
+	        client->write_buffer_len - written);
+	client->write_buffer_len -= written;
+
+	if(client->write_buffer_len == 0 && client->writable_event_source) {
+		wl_event_source_remove(client->writable_event_source);
+		client->writable_event_source = NULL;
+		ipc_buffer_shrink(&client->write_buffer, &client->write_buffer_size);
 	}
-	client->read_buf_len += received;
 
-	ipc_client_handle_command(client);
+	/* All commands of a client which hung up ran, see ipc_client_drain */
+	if(client->write_buffer_len == 0 && client->hangup && !client->pending) {
+		ipc_client_disconnect(client);
+	}
 
 	return 0;
 }
 
+/* Queues payload to be sent to client once its socket is writable. The
+ * client is not disconnected on failure, since this is called while its
+ * commands are being run. */
+bool
+ipc_send_reply(struct cg_ipc_client *client, const char *payload,
+               size_t payload_length) {
+	size_t needed = client->write_buffer_len + payload_length;
+	if(needed > MAX_WRITE_BUFFER_SIZE) {
+		wlr_log(WLR_ERROR, "Client write buffer too big (%zu), dropping reply",
+		        needed);
+		return false;
+	}
+
+	if(needed > client->write_buffer_size) {
+		size_t size = client->write_buffer_size;
+		while(size < needed) {
+			size *= 2;
+		}
+		char *new_buffer = realloc(client->write_buffer, size);
+		if(!new_buffer) {
+			wlr_log(WLR_ERROR, "Unable to reallocate ipc client write buffer");
+			return false;
+		}
+		client->write_buffer = new_buffer;
+		client->write_buffer_size = size;
+	}
+
+	memcpy(client->write_buffer + client->write_buffer_len, payload,
+	       payload_length);
+	client->write_buffer_len += payload_length;
+
+	if(!client->writable_event_source) {
+		client->writable_event_source = wl_event_loop_add_fd(
+		    client->server->event_loop, client->fd, WL_EVENT_WRITABLE,
+		    ipc_client_handle_writable, client);
+	}
+
+	return true;
+}
+
+/* Writes the output of a command to path, or sends it to the IPC client
+ * running the command if path is NULL */
+int
+ipc_send_result(struct cg_server *server, const char *path, const char *data,
+                size_t length) {
+	if(path != NULL) {
+		FILE *file = fopen(path, "w");
+		if(file == NULL) {
+			wlr_log(WLR_ERROR, "Failed to open \"%s\" for writing", path);
+			return -1;
+		}
+		int ret = 0;
+		if(fwrite(data, 1, length, file) != length) {
+			wlr_log(WLR_ERROR, "Failed to write to \"%s\"", path);
+			ret = -1;
+		}
+		if(fclose(file) != 0) {
+			ret = -1;
+		}
+		return ret;
+	}
+	if(server->ipc.current_client == NULL) {
+		wlr_log(WLR_ERROR, "Output without a file is only available over IPC");
+		return -1;
+	}
+	return ipc_send_reply(server->ipc.current_client, data, length) ? 0 : -1;
+}
+
+/* Queues payload like ipc_send_reply, passing a duplicate of fd along with
+ * its first byte. Only one file descriptor can be queued at a time. */
+bool
+ipc_send_fd(struct cg_ipc_client *client, int fd, const char *payload,
+            size_t payload_length) {
+	if(client->reply_fd != -1) {
+		wlr_log(WLR_ERROR, "Client has not received the previous file "
+		                   "descriptor yet, dropping reply");
+		return false;
+	}
+	if(payload_length == 0) {
+		return false;
+	}
+	int reply_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if(reply_fd == -1) {
+		wlr_log_errno(WLR_ERROR, "Unable to duplicate file descriptor");
+		return false;
+	}
+	size_t offset = client->write_buffer_len;
+	if(!ipc_send_reply(client, payload, payload_length)) {
+		close(reply_fd);
+		return false;
+	}
+	client->reply_fd = reply_fd;
+	client->reply_fd_offset = offset;
+	return true;
+}
+
 void
 ipc_client_disconnect(struct cg_ipc_client *client) {
 	if(client == NULL) {
@@ -219,37 +527,81 @@ ipc_client_disconnect(struct cg_ipc_client *client) {
 
 	shutdown(client->fd, SHUT_RDWR);
 
-	wl_event_source_remove(client->event_source);
+	if(client->event_source) {
+		wl_event_source_remove(client->event_source);
+	}
 	if(client->writable_event_source) {
 		wl_event_source_remove(client->writable_event_source);
 	}
 	wl_list_remove(&client->link);
 	free(client->write_buffer);
 	free(client->read_buffer);
+	if(client->reply_fd != -1) {
+		close(client->reply_fd);
+	}
 	close(client->fd);
 	free(client);
 }
 
-void
-ipc_client_handle_command(struct cg_ipc_client *client) {
-	if(client == NULL) {
-		wlr_log(WLR_ERROR,
-		        "Client \"NULL\" was passed to ipc_client_handle_command");
-		return;
+/* Stops reading from client while commands it sent are left over, so that
+ * its socket does not keep the event loop busy */
+static void
+ipc_client_set_pending(struct cg_ipc_client *client, bool pending) {
+	struct cg_ipc_handle *ipc = &client->server->ipc;
+	if(pending != client->pending) {
+		client->pending = pending;
+		if(client->event_source) {
+			wl_event_source_fd_update(client->event_source,
+			                          pending ? 0 : WL_EVENT_READABLE);
+		}
+	}
+	/* Idle sources are all run before the event loop polls again, so they
+	 * would not let input and frames through */
+	if(pending && ipc->resume_timer != NULL) {
+		wl_event_source_timer_update(ipc->resume_timer, 1);
+	}
+}
+
+/* Removes the first length bytes, which were handled, from the read buffer
+ * of client */
+static void
+ipc_client_consume(struct cg_ipc_client *client, size_t length) {
+	if(length < client->read_buf_len) {
+		memmove(client->read_buffer, client->read_buffer + length,
+		        client->read_buf_len - length);
 	}
+	client->read_buf_len -= length;
+	if(client->read_buf_len == 0) {
+		ipc_buffer_shrink(&client->read_buffer, &client->read_buf_size);
+	}
+}
+
+static void
+ipc_client_handle_lines(struct cg_ipc_client *client) {
 	client->read_buffer[client->read_buf_len] = '\0';
 	char *nl_pos;
 	uint32_t offset = 0;
-	while((nl_pos = strchr(client->read_buffer + offset, '\n')) != NULL) {
+	uint32_t budget = IPC_COMMAND_BUDGET;
+	while(budget > 0 &&
+	      (nl_pos = strchr(client->read_buffer + offset, '\n')) != NULL) {
 		if(client->read_discard) {
 			client->read_discard = 0;
 		} else {
 			*nl_pos = '\0';
 			char *line = client->read_buffer + offset;
 			if(*line != '\0' && *line != '#') {
+				TRACE_BEGIN(trace_start);
+				uint64_t watchdog_start = watchdog_begin(client->server);
+				watchdog_context(client->server, "IPC command \"%s\"", line);
 				message_clear(client->server->curr_output);
 				char *errstr;
-				if(parse_rc_line(client->server, line, &errstr) != 0) {
+				client->server->ipc.current_client = client;
+				int ret = parse_rc_line(client->server, line, &errstr);
+				client->server->ipc.current_client = NULL;
+				watchdog_end(client->server, CG_WATCHDOG_IPC, watchdog_start);
+				TRACE_END(trace_start, "ipc.command");
+				--budget;
+				if(ret != 0) {
 					if(errstr != NULL) {
 						message_printf(client->server->curr_output, "%s",
 						               errstr);
@@ -262,16 +614,147 @@ ipc_client_handle_command(struct cg_ipc_client *client) {
 		}
 		offset = (nl_pos - client->read_buffer) + 1;
 	}
-	if(offset == 0) {
+	bool more = budget == 0 && memchr(client->read_buffer + offset, '\n',
+	                                  client->read_buf_len - offset) != NULL;
+	if(!more && client->read_buf_len - offset > MAX_LINE_SIZE) {
+		/* The partial line is too long already, drop it up to its end */
 		wlr_log(WLR_ERROR, "Line received was longer that %d, discarding it",
 		        MAX_LINE_SIZE);
-		client->read_buf_len = 0;
+		offset = client->read_buf_len;
 		client->read_discard = 1;
+	}
+	if(offset == 0) {
+		/* Wait for the rest of the line */
+		return;
+	}
+	ipc_client_consume(client, offset);
+	ipc_client_set_pending(client, more);
+}
+
+/* Runs the command of a framed request and queues the reply */
+static void
+ipc_client_run_request(struct cg_ipc_client *client, uint32_t id,
+                       char *line) {
+	struct cg_server *server = client->server;
+	struct cg_ipc_reply header = {.id = id, .status = CG_IPC_STATUS_OK};
+	size_t start = client->write_buffer_len;
+	if(!ipc_send_reply(client, (const char *)&header, sizeof(header))) {
+		wlr_log(WLR_ERROR, "Dropping IPC request %u", id);
 		return;
 	}
-	if(offset < client->read_buf_len) {
-		memmove(client->read_buffer, client->read_buffer + offset,
-		        client->read_buf_len - offset);
+
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(server);
+	watchdog_context(server, "IPC request %u \"%s\"", id, line);
+	char *errstr = NULL;
+	server->ipc.current_client = client;
+	int ret = parse_command_line(server, line, &errstr);
+	server->ipc.current_client = NULL;
+	watchdog_end(server, CG_WATCHDOG_IPC, watchdog_start);
+	TRACE_END(trace_start, "ipc.command");
+
+	if(ret != 0) {
+		/* Replace what the command managed to output with the error */
+		client->write_buffer_len = start + sizeof(header);
+		if(client->reply_fd != -1 &&
+		   client->reply_fd_offset >= client->write_buffer_len) {
+			close(client->reply_fd);
+			client->reply_fd = -1;
+		}
+		const char *message =
+		    errstr != NULL ? errstr : "Failed to parse command.";
+		ipc_send_reply(client, message, strlen(message));
+		header.status = CG_IPC_STATUS_ERROR;
+		free(errstr);
+	}
+	header.length = client->write_buffer_len - start - sizeof(header);
+	memcpy(client->write_buffer + start, &header, sizeof(header));
+}
+
+/* Returns true if the read buffer of client holds a complete request */
+static bool
+ipc_client_has_request(const struct cg_ipc_client *client) {
+	struct cg_ipc_request header;
+	if(client->read_buf_len < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, client->read_buffer, sizeof(header));
+	return client->read_buf_len - sizeof(header) >= header.length;
+}
+
+static bool
+ipc_client_handle_requests(struct cg_ipc_client *client) {
+	uint32_t budget = IPC_COMMAND_BUDGET;
+	struct cg_ipc_request header;
+	while(budget > 0 && client->read_buf_len >= sizeof(header)) {
+		memcpy(&header, client->read_buffer, sizeof(header));
+		if(header.length > MAX_LINE_SIZE) {
+			wlr_log(WLR_ERROR, "IPC request longer than %d, removing client",
+			        MAX_LINE_SIZE);
+			ipc_client_disconnect(client);
+			return false;
+		}
+		if(client->read_buf_len - sizeof(header) < header.length) {
+			break;
+		}
+		char line[MAX_LINE_SIZE + 1];
+		memcpy(line, client->read_buffer + sizeof(header), header.length);
+		line[header.length] = '\0';
+		ipc_client_consume(client, sizeof(header) + header.length);
+		ipc_client_run_request(client, header.id, line);
+		--budget;
+	}
+	ipc_client_set_pending(client,
+	                       budget == 0 && ipc_client_has_request(client));
+	return true;
+}
+
+/* Runs the commands received from client. Returns false if the client was
+ * disconnected because it violated the protocol. */
+bool
+ipc_client_handle_command(struct cg_ipc_client *client) {
+	if(client == NULL) {
+		wlr_log(WLR_ERROR,
+		        "Client \"NULL\" was passed to ipc_client_handle_command");
+		return false;
+	}
+	if(client->protocol == CG_IPC_PROTOCOL_UNKNOWN) {
+		if(client->read_buf_len == 0) {
+			return true;
+		}
+		if(client->read_buffer[0] != '\0') {
+			client->protocol = CG_IPC_PROTOCOL_LINES;
+		} else if(client->read_buf_len < IPC_FRAMED_MAGIC_SIZE) {
+			return true;
+		} else if(memcmp(client->read_buffer, IPC_FRAMED_MAGIC,
+		                 IPC_FRAMED_MAGIC_SIZE) == 0) {
+			client->protocol = CG_IPC_PROTOCOL_FRAMES;
+			ipc_client_consume(client, IPC_FRAMED_MAGIC_SIZE);
+		} else {
+			wlr_log(WLR_ERROR, "Unknown IPC protocol, removing client");
+			ipc_client_disconnect(client);
+			return false;
+		}
+	}
+	if(client->protocol == CG_IPC_PROTOCOL_FRAMES) {
+		return ipc_client_handle_requests(client);
+	}
+	ipc_client_handle_lines(client);
+	return true;
+}
+
+/* Runs the next commands of the clients which exhausted their budget, after
+ * input and frames had a chance to be handled */
+int
+ipc_handle_resume(void *data) {
+	struct cg_server *server = data;
+	struct cg_ipc_client *tmp_client, *client;
+	wl_list_for_each_safe(client, tmp_client, &server->ipc.client_list, link) {
+		if(client->pending && client->hangup) {
+			ipc_client_drain(client);
+		} else if(client->pending) {
+			ipc_client_handle_command(client);
+		}
 	}
-	client->read_buf_len -= offset;
+	return 0;
 }
@@ -2,11 +2,31 @@
 #define CG_IPC_SERVER_H
 
 #include "config.h"
+#include "ipc_protocol.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <wayland-server-core.h>
 
+/* Replies which would grow the write buffer of a client beyond this are
+ * dropped */
+#define MAX_WRITE_BUFFER_SIZE (64 * 1024 * 1024)
+/* Client buffers start at this size and return to it once they are empty */
+#define IPC_INITIAL_BUFFER_SIZE 128
+/* Data a client sent is left in its socket while its read buffer is full */
+#define IPC_MAX_READ_BUFFER_SIZE (16 * 1024)
+/* Connections waiting to be accepted before new ones are refused */
+#define IPC_LISTEN_BACKLOG 128
+/* Number of commands run per client before input and frames are handled */
+#define IPC_COMMAND_BUDGET 16
+
+enum cg_ipc_protocol {
+	CG_IPC_PROTOCOL_UNKNOWN, // Nothing was received yet
+	CG_IPC_PROTOCOL_LINES,
+	CG_IPC_PROTOCOL_FRAMES,
+};
+
 struct cg_server;
 
 struct cg_ipc_client {
@@ -16,12 +36,20 @@ struct cg_ipc_client {
 	struct wl_list link;
 	int fd;
 	uint32_t security_policy;
+	enum cg_ipc_protocol protocol;
 	size_t write_buffer_len;
 	size_t write_buffer_size;
 	char *write_buffer;
+	/* File descriptor sent along with the byte at reply_fd_offset of
+	 * write_buffer, -1 if there is none */
+	int reply_fd;
+	size_t reply_fd_offset;
 	// The following is for storing data between event_loop calls
-	uint16_t read_buf_len;
+	size_t read_buf_len;
+	size_t read_buf_size;
 	uint8_t read_discard; // 1 if the current line is to be discarded
+	bool pending; // Complete lines are left over after the command budget
+	bool hangup;  // The client closed its end, its last commands are run
 	char *read_buffer;
 };
 
@@ -31,20 +59,36 @@ struct cg_ipc_handle {
 	struct wl_list client_list;
 	struct wl_listener display_destroy;
 	struct sockaddr_un *sockaddr;
+	/* The client whose command is being run, NULL outside of IPC */
+	struct cg_ipc_client *current_client;
+	/* Runs the commands of clients which exhausted their budget */
+	struct wl_event_source *resume_timer;
 };
 
 int
 ipc_init(struct cg_server *server);
 int
 ipc_handle_connection(int fd, uint32_t mask, void *data);
+struct cg_ipc_client *
+ipc_client_create(struct cg_server *server, int client_fd);
 int
 ipc_client_handle_readable(int client_fd, uint32_t mask, void *data);
-// int ipc_client_handle_writable(int client_fd, uint32_t mask, void *data);
+int
+ipc_client_handle_writable(int client_fd, uint32_t mask, void *data);
 void
 ipc_client_disconnect(struct cg_ipc_client *client);
-void
+bool
 ipc_client_handle_command(struct cg_ipc_client *client);
-// bool ipc_send_reply(struct ipc_client *client, const char *payload, uint32_t
-// payload_length);
+int
+ipc_handle_resume(void *data);
+bool
+ipc_send_reply(struct cg_ipc_client *client, const char *payload,
+               size_t payload_length);
+bool
+ipc_send_fd(struct cg_ipc_client *client, int fd, const char *payload,
+            size_t payload_length);
+int
+ipc_send_result(struct cg_server *server, const char *path, const char *data,
+                size_t length);
 
 #endif
@@ -1,11 +1,11 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <string.h>
-#include <sys/wait.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/backend/multi.h>
 #include <wlr/backend/session.h>
+#include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_output_damage.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/util/log.h>
@@ -13,11 +13,17 @@
 #include "input.h"
 #include "input_manager.h"
 #include "keybinding.h"
+#include "latency.h"
+#include "layout.h"
 #include "message.h"
 #include "output.h"
+#include "process.h"
 #include "seat.h"
 #include "server.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "view.h"
+#include "watchdog.h"
 #include "workspace.h"
 
 int
@@ -42,7 +48,7 @@ find_keybinding(const struct keybinding_list *list,
 	struct keybinding **it = list->keybindings;
 	for(size_t i = 0; i < list->length; ++i, ++it) {
 		if(!(keybinding->modifiers ^ (*it)->modifiers) &&
-		   keybinding->mode == (*it)->mode && keybinding->key == (*it)->key) {
+		   keybinding->key == (*it)->key) {
 			return it;
 		}
 	}
@@ -54,6 +60,11 @@ keybinding_free(struct keybinding *keybinding, bool recursive) {
 	switch(keybinding->action) {
 	case KEYBINDING_DEFINEMODE:
 	case KEYBINDING_RUN_COMMAND:
+	case KEYBINDING_DUMP_LAYOUT:
+	case KEYBINDING_RESTORE_LAYOUT:
+	case KEYBINDING_DUMP_TRACE:
+	case KEYBINDING_DUMP_LATENCY:
+	case KEYBINDING_DUMP_WATCHDOG:
 		if(keybinding->data.c != NULL) {
 			free(keybinding->data.c);
 		}
@@ -63,6 +74,13 @@ keybinding_free(struct keybinding *keybinding, bool recursive) {
 			keybinding_free(keybinding->data.kb, true);
 		}
 		break;
+	case KEYBINDING_SEQUENCE_PREFIX:
+		keybinding_list_free(keybinding->data.kl);
+		break;
+	case KEYBINDING_CONFIGURE_MESSAGE:
+		free(keybinding->data.m_cfg->font);
+		free(keybinding->data.m_cfg);
+		break;
 	case KEYBINDING_CONFIGURE_OUTPUT:
 		free(keybinding->data.o_cfg->output_name);
 		free(keybinding->data.o_cfg);
@@ -94,7 +112,23 @@ keybinding_list_push(struct keybinding_list *list,
 	/*Maintain that only a single keybinding for a key, modifier and mode may
 	 * exist*/
 	struct keybinding **found_keybinding = find_keybinding(list, keybinding);
-	if(found_keybinding != NULL) {
+	if(found_keybinding != NULL &&
+	   (*found_keybinding)->action == KEYBINDING_SEQUENCE_PREFIX &&
+	   keybinding->action == KEYBINDING_SEQUENCE_PREFIX) {
+		/* Sequences sharing a prefix are merged into the existing trie node */
+		struct keybinding_list *children = keybinding->data.kl;
+		for(uint32_t i = 0; i < children->length; ++i) {
+			if(keybinding_list_push((*found_keybinding)->data.kl,
+			                        children->keybindings[i]) != 0) {
+				for(uint32_t j = i; j < children->length; ++j) {
+					keybinding_free(children->keybindings[j], true);
+				}
+				break;
+			}
+		}
+		children->length = 0;
+		keybinding_free(keybinding, true);
+	} else if(found_keybinding != NULL) {
 		keybinding_free(*found_keybinding, true);
 		*found_keybinding = keybinding;
 		wlr_log(WLR_DEBUG, "A keybinding was found twice in the config file.");
@@ -108,7 +142,14 @@ keybinding_list_push(struct keybinding_list *list,
 struct keybinding_list *
 keybinding_list_init() {
 	struct keybinding_list *list = malloc(sizeof(struct keybinding_list));
+	if(list == NULL) {
+		return NULL;
+	}
 	list->keybindings = malloc(sizeof(struct keybinding *));
+	if(list->keybindings == NULL) {
+		free(list);
+		return NULL;
+	}
 	list->capacity = 1;
 	list->length = 0;
 	return list;
@@ -126,62 +167,123 @@ keybinding_list_free(struct keybinding_list *list) {
 	free(list);
 }
 
-struct cg_tile *
-find_right_tile(const struct cg_tile *tile) {
-	struct cg_tile *it = tile->next;
-	while(it != tile && it->tile.x != tile->tile.x + tile->tile.width) {
-		it = it->next;
-	}
-	if(it == tile) {
-		return NULL;
-	} else {
-		return it;
-	}
-}
-
-struct cg_tile *
-find_left_tile(const struct cg_tile *tile) {
-	struct cg_tile *it = tile->prev;
-	while(it != tile && it->tile.x + it->tile.width != tile->tile.x) {
-		it = it->prev;
-	}
-	if(it == tile) {
-		return NULL;
-	} else {
-		return it;
-	}
-}
-
-struct cg_tile *
-find_top_tile(const struct cg_tile *tile) {
-	struct cg_tile *it = tile->prev;
-	while(it != tile && it->tile.y + it->tile.height != tile->tile.y) {
-		it = it->prev;
-	}
-	if(it == tile) {
-		return NULL;
-	} else {
-		return it;
-	}
+/* Returns the command which is run by keybinding, for log messages */
+const char *
+keybinding_command_name(const struct keybinding *keybinding) {
+	switch(keybinding->action) {
+	case KEYBINDING_RUN_COMMAND:
+		return "exec";
+	case KEYBINDING_CLOSE_VIEW:
+		return "close";
+	case KEYBINDING_SPLIT_VERTICAL:
+		return "vsplit";
+	case KEYBINDING_SPLIT_HORIZONTAL:
+		return "hsplit";
+	case KEYBINDING_CHANGE_TTY:
+		return "switchvt";
+	case KEYBINDING_LAYOUT_FULLSCREEN:
+		return "only";
+	case KEYBINDING_CYCLE_VIEWS:
+		return keybinding->data.b ? "prev" : "next";
+	case KEYBINDING_CYCLE_TILES:
+		return keybinding->data.b ? "focusprev" : "focus";
+	case KEYBINDING_CYCLE_OUTPUT:
+		return keybinding->data.b ? "prevscreen" : "nextscreen";
+	case KEYBINDING_CONFIGURE_OUTPUT:
+		return "output";
+	case KEYBINDING_CONFIGURE_MESSAGE:
+		return "configure_message";
+	case KEYBINDING_CONFIGURE_INPUT:
+		return "input";
+	case KEYBINDING_QUIT:
+		return "quit";
+	case KEYBINDING_NOOP:
+		return "abort";
+	case KEYBINDING_SWITCH_OUTPUT:
+		return "screen";
+	case KEYBINDING_SWITCH_WORKSPACE:
+		return "workspace";
+	case KEYBINDING_SWITCH_MODE:
+		return "mode";
+	case KEYBINDING_SWITCH_DEFAULT_MODE:
+		return "setmode";
+	case KEYBINDING_RESIZE_TILE_HORIZONTAL:
+		return keybinding->data.i < 0 ? "resizeleft" : "resizeright";
+	case KEYBINDING_RESIZE_TILE_VERTICAL:
+		return keybinding->data.i < 0 ? "resizeup" : "resizedown";
+	case KEYBINDING_MOVE_VIEW_TO_WORKSPACE:
+		return "movetoworkspace";
+	case KEYBINDING_MOVE_VIEW_TO_OUTPUT:
+		return "movetoscreen";
+	case KEYBINDING_MOVE_VIEW_TO_CYCLE_OUTPUT:
+		return keybinding->data.b ? "movetoprevscreen" : "movetonextscreen";
+	case KEYBINDING_SHOW_TIME:
+		return "time";
+	case KEYBINDING_SHOW_INFO:
+		return "show_info";
+	case KEYBINDING_DISPLAY_MESSAGE:
+		return "message";
+	case KEYBINDING_SWAP_LEFT:
+		return "exchangeleft";
+	case KEYBINDING_SWAP_RIGHT:
+		return "exchangeright";
+	case KEYBINDING_SWAP_TOP:
+		return "exchangeup";
+	case KEYBINDING_SWAP_BOTTOM:
+		return "exchangedown";
+	case KEYBINDING_FOCUS_LEFT:
+		return "focusleft";
+	case KEYBINDING_FOCUS_RIGHT:
+		return "focusright";
+	case KEYBINDING_FOCUS_TOP:
+		return "focusup";
+	case KEYBINDING_FOCUS_BOTTOM:
+		return "focusdown";
+	case KEYBINDING_DEFINEKEY:
+	case KEYBINDING_SEQUENCE_PREFIX:
+		return "definekey";
+	case KEYBINDING_BACKGROUND:
+		return "background";
+	case KEYBINDING_DEFINEMODE:
+		return "definemode";
+	case KEYBINDING_WORKSPACES:
+		return "workspaces";
+	case KEYBINDING_SEQUENCE_TIMEOUT:
+		return "sequencetimeout";
+	case KEYBINDING_DUMP_LAYOUT:
+		return "dumplayout";
+	case KEYBINDING_RESTORE_LAYOUT:
+		return "restorelayout";
+	case KEYBINDING_XWAYLAND_IDLE:
+		return "xwaylandidle";
+	case KEYBINDING_DUMP_TRACE:
+		return "dumptrace";
+	case KEYBINDING_DUMP_LATENCY:
+		return "dumplatency";
+	case KEYBINDING_WATCHDOG:
+		return "watchdog";
+	case KEYBINDING_DUMP_WATCHDOG:
+		return "dumpwatchdog";
+	case KEYBINDING_SNAPSHOT:
+		return "snapshot";
+	}
+	return "unknown";
 }
 
-struct cg_tile *
-find_bottom_tile(const struct cg_tile *tile) {
-	struct cg_tile *it = tile->next;
-	while(it != tile && it->tile.y != tile->tile.y + tile->tile.height) {
-		it = it->next;
-	}
-	if(it == tile) {
-		return NULL;
-	} else {
-		return it;
-	}
+static struct cg_tile *
+find_tile(const struct cg_tile *tile, enum cg_tile_direction dir) {
+	struct cg_server *server = tile->workspace->server;
+	double cursor_x = server->seat->cursor->x;
+	double cursor_y = server->seat->cursor->y;
+	wlr_output_layout_output_coords(server->output_layout,
+	                                tile->workspace->output->wlr_output,
+	                                &cursor_x, &cursor_y);
+	return tile_find_neighbour(tile, dir, cursor_x, cursor_y);
 }
 
 void
-swap_tile(struct cg_tile *tile,
-          struct cg_tile *(*find_tile)(const struct cg_tile *)) {
-	struct cg_tile *swap_tile = find_tile(tile);
+swap_tile(struct cg_tile *tile, enum cg_tile_direction dir) {
+	struct cg_tile *swap_tile = find_tile(tile, dir);
 	struct cg_server *server = tile->workspace->server;
 	if(swap_tile == NULL || swap_tile == tile) {
 		return;
@@ -211,28 +313,27 @@ swap_tile(struct cg_tile *tile,
 
 void
 swap_tile_left(struct cg_tile *tile) {
-	swap_tile(tile, find_left_tile);
+	swap_tile(tile, CG_TILE_LEFT);
 }
 
 void
 swap_tile_right(struct cg_tile *tile) {
-	swap_tile(tile, find_right_tile);
+	swap_tile(tile, CG_TILE_RIGHT);
 }
 
 void
 swap_tile_top(struct cg_tile *tile) {
-	swap_tile(tile, find_top_tile);
+	swap_tile(tile, CG_TILE_TOP);
 }
 
 void
 swap_tile_bottom(struct cg_tile *tile) {
-	swap_tile(tile, find_bottom_tile);
+	swap_tile(tile, CG_TILE_BOTTOM);
 }
 
 void
-focus_tile(struct cg_tile *tile,
-           struct cg_tile *(*find_tile)(const struct cg_tile *tile)) {
-	struct cg_tile *new_tile = find_tile(tile);
+focus_tile(struct cg_tile *tile, enum cg_tile_direction dir) {
+	struct cg_tile *new_tile = find_tile(tile, dir);
 	if(new_tile == NULL) {
 		return;
 	}
@@ -243,22 +344,22 @@ focus_tile(struct cg_tile *tile,
 
 void
 focus_tile_left(struct cg_tile *tile) {
-	focus_tile(tile, find_left_tile);
+	focus_tile(tile, CG_TILE_LEFT);
 }
 
 void
 focus_tile_right(struct cg_tile *tile) {
-	focus_tile(tile, find_right_tile);
+	focus_tile(tile, CG_TILE_RIGHT);
 }
 
 void
 focus_tile_top(struct cg_tile *tile) {
-	focus_tile(tile, find_top_tile);
+	focus_tile(tile, CG_TILE_TOP);
 }
 
 void
 focus_tile_bottom(struct cg_tile *tile) {
-	focus_tile(tile, find_bottom_tile);
+	focus_tile(tile, CG_TILE_BOTTOM);
 }
 
 // Returns whether x is between a and b (a exclusive, b exclusive) where
@@ -446,6 +547,7 @@ resize_tile(struct cg_server *server, int hpixs, int vpixs) {
 			resize_vertical(focused, NULL, y_offset, vpixs);
 		}
 	}
+	workspace_update_neighbours(output->workspaces[output->curr_workspace]);
 }
 
 void
@@ -478,6 +580,7 @@ keybinding_workspace_fullscreen(struct cg_server *server) {
 	                 &output->workspaces[output->curr_workspace]->views, link) {
 		it_view->tile =
 		    output->workspaces[output->curr_workspace]->focused_tile;
+		view_update_hidden(it_view);
 	}
 
 	seat_set_focus(server->seat, current_view);
@@ -522,13 +625,9 @@ keybinding_split_output(struct cg_output *output, bool vertical) {
 	}
 
 	struct cg_view *next_view = NULL;
-	struct cg_view *it;
-	wl_list_for_each(it, &output->workspaces[output->curr_workspace]->views,
-	                 link) {
-		if(!view_is_visible(it) && original_view != it) {
-			next_view = it;
-			break;
-		}
+	if(!wl_list_empty(&curr_workspace->hidden_views)) {
+		next_view = wl_container_of(curr_workspace->hidden_views.next,
+		                            next_view, hidden_link);
 	}
 
 	int32_t new_x, new_y;
@@ -540,7 +639,7 @@ keybinding_split_output(struct cg_output *output, bool vertical) {
 		new_y = y + new_height;
 	}
 
-	struct cg_tile *new_tile = calloc(1, sizeof(struct cg_tile));
+	struct cg_tile *new_tile = pool_alloc(&output->server->tile_pool);
 	if(!new_tile) {
 		wlr_log(WLR_ERROR, "Failed to allocate new tile for splitting");
 		return;
@@ -558,10 +657,12 @@ keybinding_split_output(struct cg_output *output, bool vertical) {
 
 	curr_workspace->focused_tile->tile.width = new_width;
 	curr_workspace->focused_tile->tile.height = new_height;
+	workspace_update_neighbours(curr_workspace);
 	workspace_focus_tile(curr_workspace, curr_workspace->focused_tile);
 
 	if(next_view != NULL) {
 		view_maximize(next_view, new_tile);
+		view_update_hidden(next_view);
 	}
 
 	if(original_view != NULL) {
@@ -587,12 +688,6 @@ keybinding_split_horizontal(struct cg_server *server) {
 	keybinding_split_output(server->curr_output, false);
 }
 
-static void
-into_process(const char *command) {
-	execl("/bin/sh", "sh", "-c", command, (char *)NULL);
-	_exit(1);
-}
-
 void
 keybinding_cycle_outputs(struct cg_server *server, bool reverse) {
 	if(reverse) {
@@ -618,46 +713,42 @@ keybinding_cycle_outputs(struct cg_server *server, bool reverse) {
 	message_printf(server->curr_output, "Current Output");
 }
 
-/* Cycle through views, whereby the workspace does not change */
+/* Cycle through views, whereby the workspace does not change.
+ * Together with the current view, the hidden views form a ring: cycling
+ * forward shows the least recently hidden view and queues the current one as
+ * the most recent, cycling backwards does the opposite. */
 void
 keybinding_cycle_views(struct cg_server *server, bool reverse) {
 	struct cg_workspace *curr_workspace =
 	    server->curr_output->workspaces[server->curr_output->curr_workspace];
 	struct cg_view *current_view = curr_workspace->focused_tile->view;
 
-	if(current_view == NULL) {
-		current_view =
-		    wl_container_of(&curr_workspace->views, current_view, link);
+	if(wl_list_empty(&curr_workspace->hidden_views)) {
+		return;
 	}
-	struct cg_view *it_view, *next_view = NULL;
+	struct cg_view *next_view;
 	if(reverse) {
-		next_view = view_get_prev_view(current_view);
+		next_view = wl_container_of(curr_workspace->hidden_views.next,
+		                            next_view, hidden_link);
 	} else {
-		struct wl_list *it;
-		it = current_view->link.next;
-		while(it != &current_view->link) {
-			if(it == &curr_workspace->views) {
-				it = it->next;
-				continue;
-			}
-			it_view = wl_container_of(it, it_view, link);
-			if(!view_is_visible(it_view)) {
-				next_view = it_view;
-				break;
-			}
-			it = it->next;
-		}
-	}
-
-	if(next_view == NULL) {
-		return;
+		next_view = wl_container_of(curr_workspace->hidden_views.prev,
+		                            next_view, hidden_link);
 	}
 
 	wlr_output_damage_add_box(curr_workspace->output->damage,
 	                          &curr_workspace->focused_tile->tile);
-	/* Prevent seat_set_focus from reordering the views */
-	curr_workspace->focused_tile->view = wl_container_of(
-	    next_view->link.prev, curr_workspace->focused_tile->view, link);
+	/* Show the view directly, so that seat_set_focus does not reorder the
+	 * views */
+	curr_workspace->focused_tile->view = next_view;
+	view_maximize(next_view, curr_workspace->focused_tile);
+	view_update_hidden(next_view);
+	view_update_hidden(current_view);
+	if(reverse && current_view != NULL &&
+	   !wl_list_empty(&current_view->hidden_link)) {
+		wl_list_remove(&current_view->hidden_link);
+		wl_list_insert(curr_workspace->hidden_views.prev,
+		               &current_view->hidden_link);
+	}
 	seat_set_focus(server->seat, next_view);
 }
 
@@ -684,9 +775,14 @@ keybinding_switch_ws(struct cg_server *server, uint32_t ws) {
 		return -1;
 	}
 	struct cg_output *output = server->curr_output;
+	struct cg_workspace *workspace = output_get_workspace(output, ws);
+	if(workspace == NULL) {
+		return -1;
+	}
+	uint32_t prev_ws = output->curr_workspace;
 	output->curr_workspace = ws;
-	seat_set_focus(server->seat,
-	               server->curr_output->workspaces[ws]->focused_tile->view);
+	output_reclaim_workspace(output, prev_ws);
+	seat_set_focus(server->seat, workspace->focused_tile->view);
 	wlr_output_damage_add_whole(output->damage);
 	message_printf(server->curr_output, "Workspace %d", ws + 1);
 	return 0;
@@ -744,16 +840,16 @@ keybinding_move_view_to_cycle_output(struct cg_server *server, bool reverse) {
 	}
 	keybinding_cycle_outputs(server, false);
 	if(view != NULL) {
-		wl_list_insert(&server->curr_output
-		                    ->workspaces[server->curr_output->curr_workspace]
-		                    ->views,
-		               &view->link);
-		server->curr_output->workspaces[server->curr_output->curr_workspace]
-		    ->focused_tile->view = view;
-		view->workspace = server->curr_output
-		                      ->workspaces[server->curr_output->curr_workspace];
+		struct cg_workspace *ws =
+		    server->curr_output
+		        ->workspaces[server->curr_output->curr_workspace];
+		struct cg_view *hidden_view = ws->focused_tile->view;
+		wl_list_insert(&ws->views, &view->link);
+		ws->focused_tile->view = view;
+		view->workspace = ws;
 		view->tile = view->workspace->focused_tile;
 		view_maximize(view, view->tile);
+		view_update_hidden(hidden_view);
 		seat_set_focus(server->seat, view);
 	}
 }
@@ -763,22 +859,39 @@ keybinding_set_nws(struct cg_server *server, int nws) {
 	struct cg_output *output;
 	wl_list_for_each(output, &server->outputs, link) {
 		for(unsigned int i = nws; i < server->nws; ++i) {
-			struct cg_view *view, *tmp;
-			wl_list_for_each_safe(view, tmp, &output->workspaces[i]->views,
-			                      link) {
-				wl_list_remove(&view->link);
-				wl_list_insert(&output->workspaces[nws - 1]->views,
-				               &view->link);
-				view->workspace = output->workspaces[nws - 1];
+			struct cg_workspace *removed = output->workspaces[i];
+			if(removed == NULL) {
+				continue;
 			}
-			wl_list_for_each_safe(
-			    view, tmp, &output->workspaces[i]->unmanaged_views, link) {
-				wl_list_remove(&view->link);
-				wl_list_insert(&output->workspaces[nws - 1]->unmanaged_views,
-				               &view->link);
-				view->workspace = output->workspaces[nws - 1];
+			struct cg_workspace *last = NULL;
+			if(!workspace_is_empty(removed) ||
+			   (int)i == output->curr_workspace) {
+				last = output_get_workspace(output, nws - 1);
+				if(last == NULL) {
+					return;
+				}
 			}
-			workspace_free(output->workspaces[i]);
+			if(last != NULL) {
+				struct cg_view *view, *tmp;
+				wl_list_for_each_safe(view, tmp, &removed->views, link) {
+					wl_list_remove(&view->link);
+					view_unqueue_hidden(view);
+					wl_list_insert(&last->views, &view->link);
+					view->workspace = last;
+					/* The tiles of the removed workspace are freed below */
+					view->tile = last->focused_tile;
+					view_update_hidden(view);
+				}
+				wl_list_for_each_safe(view, tmp, &removed->unmanaged_views,
+				                      link) {
+					wl_list_remove(&view->link);
+					wl_list_insert(&last->unmanaged_views, &view->link);
+					view->workspace = last;
+				}
+				workspace_update_unmanaged_box(last);
+			}
+			workspace_free(removed);
+			output->workspaces[i] = NULL;
 		}
 		struct cg_workspace **new_workspaces =
 		    realloc(output->workspaces, nws * sizeof(struct cg_workspace *));
@@ -788,14 +901,7 @@ keybinding_set_nws(struct cg_server *server, int nws) {
 		}
 		output->workspaces = new_workspaces;
 		for(int i = server->nws; i < nws; ++i) {
-			output->workspaces[i] = full_screen_workspace(output);
-			if(!output->workspaces[i]) {
-				wlr_log(WLR_ERROR, "Failed to allocate additional workspaces");
-				return;
-			}
-
-			wl_list_init(&output->workspaces[i]->views);
-			wl_list_init(&output->workspaces[i]->unmanaged_views);
+			output->workspaces[i] = NULL;
 		}
 
 		if(output->curr_workspace >= nws) {
@@ -811,23 +917,37 @@ keybinding_set_nws(struct cg_server *server, int nws) {
 
 void
 keybinding_definemode(struct cg_server *server, char *mode) {
-	int length = 0;
-	while(server->modes[length++] != NULL)
-		;
-	char **tmp = realloc(server->modes, (length + 1) * sizeof(char *));
-	if(tmp == NULL) {
-		wlr_log(WLR_ERROR, "Could not allocate memory for storing modes.");
-		return;
+	if(server_add_mode(server, mode) == -1) {
+		wlr_log(WLR_ERROR, "Unable to define mode \"%s\"", mode);
 	}
-	server->modes = tmp;
-	server->modes[length] = NULL;
-
-	server->modes[length - 1] = strdup(mode);
 }
 
 void
 keybinding_definekey(struct cg_server *server, struct keybinding *kb) {
-	keybinding_list_push(server->keybindings, kb);
+	/* Redefining keys may free the trie node of a pending key sequence */
+	if(server->seat != NULL) {
+		server->seat->pending_sequence = NULL;
+	}
+	if(kb->mode >= server->nmodes) {
+		wlr_log(WLR_ERROR, "Keybinding refers to unknown mode %d", kb->mode);
+		keybinding_free(kb, true);
+		return;
+	}
+	if(keybinding_list_push(server->modes[kb->mode].keybindings, kb) != 0) {
+		wlr_log(WLR_ERROR, "Could not allocate memory for keybinding");
+		keybinding_free(kb, true);
+	}
+}
+
+void
+keybinding_configure_message(struct cg_server *server,
+                             const struct cg_message_config *cfg) {
+	if(cfg->display_time >= 0) {
+		server->message_timeout = cfg->display_time;
+	}
+	if(cfg->coalesce >= 0) {
+		server->message_coalesce = cfg->coalesce;
+	}
 }
 
 void
@@ -839,28 +959,36 @@ keybinding_set_background(struct cg_server *server, float *bg) {
 
 void
 keybinding_move_view_to_workspace(struct cg_server *server, uint32_t ws) {
-	struct cg_view *view =
-	    server->curr_output->workspaces[server->curr_output->curr_workspace]
-	        ->focused_tile->view;
+	struct cg_output *output = server->curr_output;
+	struct cg_workspace *curr_ws = output->workspaces[output->curr_workspace];
+	struct cg_view *view = curr_ws->focused_tile->view;
 	if(view != NULL) {
+		/* Switching away frees the current workspace if the view was the
+		 * last thing on it, so the view must not point into it anymore */
+		struct cg_workspace *target = NULL;
+		if(ws < server->nws) {
+			target = output_get_workspace(output, ws);
+		}
+		if(target == NULL) {
+			target = curr_ws;
+		}
 		wl_list_remove(&view->link);
-		server->curr_output->workspaces[server->curr_output->curr_workspace]
-		    ->focused_tile->view = NULL;
+		curr_ws->focused_tile->view = NULL;
+		view->workspace = target;
+		view->tile = target->focused_tile;
 		keybinding_cycle_views(server, false);
-		if(server->curr_output->workspaces[server->curr_output->curr_workspace]
-		       ->focused_tile->view == NULL) {
+		if(curr_ws->focused_tile->view == NULL) {
 			seat_set_focus(server->seat, NULL);
 		}
 	}
 	keybinding_switch_ws(server, ws);
 	if(view != NULL) {
-		struct cg_workspace *ws =
-		    server->curr_output
-		        ->workspaces[server->curr_output->curr_workspace];
-		view->workspace = ws;
+		struct cg_workspace *ws = view->workspace;
+		struct cg_view *hidden_view = ws->focused_tile->view;
 		wl_list_insert(&ws->views, &view->link);
 		ws->focused_tile->view = view;
 		view_maximize(view, ws->focused_tile);
+		view_update_hidden(hidden_view);
 		seat_set_focus(server->seat, view);
 	}
 }
@@ -918,6 +1046,7 @@ keybinding_configure_input_dev(struct cg_server *server,
 int
 run_action(enum keybinding_action action, struct cg_server *server,
            union keybinding_params data) {
+	snapshot_schedule(server);
 	switch(action) {
 	case KEYBINDING_QUIT:
 		display_terminate(server);
@@ -933,17 +1062,8 @@ run_action(enum keybinding_action action, struct cg_server *server,
 	case KEYBINDING_SPLIT_VERTICAL:
 		keybinding_split_vertical(server);
 		break;
-	case KEYBINDING_RUN_COMMAND: {
-		int pid;
-		if((pid = fork()) == 0) {
-			if(fork() == 0) {
-				into_process(data.c);
-			}
-			_exit(0);
-		} else if(pid > 0) {
-			waitpid(pid, NULL, 0);
-		}
-	} break;
+	case KEYBINDING_RUN_COMMAND:
+		return process_spawn(data.c);
 	case KEYBINDING_CYCLE_VIEWS:
 		keybinding_cycle_views(server, data.b);
 		break;
@@ -1042,6 +1162,38 @@ run_action(enum keybinding_action action, struct cg_server *server,
 	case KEYBINDING_DEFINEMODE:
 		keybinding_definemode(server, data.c);
 		break;
+	case KEYBINDING_SEQUENCE_PREFIX:
+		/* Prefixes are only meaningful while handling key presses */
+		break;
+	case KEYBINDING_CONFIGURE_MESSAGE:
+		keybinding_configure_message(server, data.m_cfg);
+		break;
+	case KEYBINDING_SEQUENCE_TIMEOUT:
+		server->sequence_timeout = data.u;
+		break;
+	case KEYBINDING_XWAYLAND_IDLE:
+		server->xwayland_idle_timeout = data.u;
+#if CG_HAS_XWAYLAND
+		if(server->xwayland_surfaces == 0) {
+			wl_event_source_timer_update(server->xwayland_idle, data.u * 1000);
+		}
+#endif
+		break;
+	case KEYBINDING_DUMP_LAYOUT:
+		return layout_dump(server, data.c);
+	case KEYBINDING_RESTORE_LAYOUT:
+		return layout_restore(server, data.c);
+	case KEYBINDING_DUMP_TRACE:
+		return trace_dump(server, data.c);
+	case KEYBINDING_DUMP_LATENCY:
+		return latency_dump(server, data.c);
+	case KEYBINDING_WATCHDOG:
+		watchdog_set_budget(server, data.u);
+		break;
+	case KEYBINDING_DUMP_WATCHDOG:
+		return watchdog_dump(server, data.c);
+	case KEYBINDING_SNAPSHOT:
+		return snapshot_send(server);
 	case KEYBINDING_WORKSPACES:
 		keybinding_set_nws(server, data.i);
 		break;
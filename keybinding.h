@@ -60,6 +60,21 @@ enum keybinding_action {
 	KEYBINDING_BACKGROUND, // data.color is the background color
 	KEYBINDING_DEFINEMODE, // data.c is the mode name
 	KEYBINDING_WORKSPACES, // data.i is the number of workspaces
+	KEYBINDING_SEQUENCE_PREFIX,  // data.kl holds the bindings for the next
+	                             // key of the sequence
+	KEYBINDING_SEQUENCE_TIMEOUT, // data.u is the timeout in milliseconds
+	KEYBINDING_DUMP_LAYOUT,      // data.c is the file to write the layout to,
+	                             // NULL to reply over IPC
+	KEYBINDING_RESTORE_LAYOUT,   // data.c is the file to read the layout from
+	KEYBINDING_XWAYLAND_IDLE,    // data.u is the timeout in seconds
+	KEYBINDING_DUMP_TRACE,       // data.c is the file to write the trace to,
+	                             // NULL to reply over IPC
+	KEYBINDING_DUMP_LATENCY,     // data.c is the file to write the latency
+	                             // statistics to, NULL to reply over IPC
+	KEYBINDING_WATCHDOG,         // data.u is the budget in milliseconds
+	KEYBINDING_DUMP_WATCHDOG,    // data.c is the file to write the counters
+	                             // to, NULL to reply over IPC
+	KEYBINDING_SNAPSHOT,
 };
 
 union keybinding_params {
@@ -69,6 +84,7 @@ union keybinding_params {
 	bool b;
 	float color[3];
 	struct keybinding *kb;
+	struct keybinding_list *kl;
 	struct cg_output_config *o_cfg;
 	struct cg_input_config *i_cfg;
 	struct cg_message_config *m_cfg;
@@ -106,5 +122,7 @@ run_action(enum keybinding_action action, struct cg_server *server,
            union keybinding_params data);
 void
 keybinding_free(struct keybinding *keybinding, bool recursive);
+const char *
+keybinding_command_name(const struct keybinding *keybinding);
 
 #endif /* end of include guard KEYBINDINGS_H */
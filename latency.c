@@ -0,0 +1,274 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/util/log.h>
+
+#include "ipc_server.h"
+#include "latency.h"
+#include "server.h"
+#include "util.h"
+
+/* Number of recent events per source the percentiles are computed over */
+#define LATENCY_SAMPLES 1024
+/* Inputs which were not presented within this time had no visible effect */
+#define LATENCY_MAX_AGE_NS 1000000000ULL
+#define LATENCY_NONE UINT32_MAX
+
+/* Times in microseconds after the input event, commit is LATENCY_NONE if no
+ * client committed before the frame was rendered */
+struct cg_latency_sample {
+	uint32_t commit;
+	uint32_t render;
+	uint32_t present;
+};
+
+/* The oldest input of a source which has not been presented yet. Times are in
+ * nanoseconds on CLOCK_MONOTONIC, 0 until the stage was reached. */
+struct cg_latency_pending {
+	uint64_t input;
+	uint64_t commit;
+	uint64_t render;
+};
+
+struct cg_latency_track {
+	struct cg_latency_pending pending;
+	struct cg_latency_sample samples[LATENCY_SAMPLES];
+	uint64_t nsamples; // Number of samples recorded since startup
+};
+
+struct cg_latency {
+	uint32_t pending_mask; // Bit i is set if tracks[i] has a pending input
+	struct cg_latency_track tracks[CG_LATENCY_SOURCES];
+};
+
+static const char *const source_names[CG_LATENCY_SOURCES] = {
+    [CG_LATENCY_KEY] = "key",
+    [CG_LATENCY_BUTTON] = "button",
+    [CG_LATENCY_MOTION] = "motion",
+};
+
+static uint64_t
+timespec_to_ns(const struct timespec *ts) {
+	return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+int
+latency_init(struct cg_server *server) {
+	server->latency = calloc(1, sizeof(struct cg_latency));
+	if(server->latency == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate latency statistics");
+		return -1;
+	}
+	return 0;
+}
+
+void
+latency_fini(struct cg_server *server) {
+	free(server->latency);
+	server->latency = NULL;
+}
+
+/* Starts measuring an input event unless an older one of the same source is
+ * still waiting to be presented. time_msec is the millisecond timestamp of
+ * the event on CLOCK_MONOTONIC, which wraps around after 49 days. */
+void
+latency_input(struct cg_server *server, enum cg_latency_source source,
+              uint32_t time_msec) {
+	struct cg_latency *latency = server->latency;
+	if(latency == NULL) {
+		return;
+	}
+	uint64_t now = monotonic_ns();
+	if(latency->pending_mask & (1u << source) &&
+	   now - latency->tracks[source].pending.input <= LATENCY_MAX_AGE_NS) {
+		return;
+	}
+	uint32_t age_ms = (uint32_t)(now / 1000000) - time_msec;
+	if(age_ms > LATENCY_MAX_AGE_NS / 1000000) {
+		/* Not on CLOCK_MONOTONIC, e.g. forwarded by a parent compositor */
+		return;
+	}
+	latency->tracks[source].pending = (struct cg_latency_pending){
+	    .input = now - (uint64_t)age_ms * 1000000,
+	};
+	latency->pending_mask |= 1u << source;
+}
+
+/* Called when a client commits a new buffer */
+void
+latency_commit(struct cg_server *server) {
+	struct cg_latency *latency = server->latency;
+	if(latency == NULL || latency->pending_mask == 0) {
+		return;
+	}
+	uint64_t now = 0;
+	for(int i = 0; i < CG_LATENCY_SOURCES; ++i) {
+		struct cg_latency_pending *pending = &latency->tracks[i].pending;
+		if(latency->pending_mask & (1u << i) && pending->commit == 0) {
+			now = now != 0 ? now : monotonic_ns();
+			pending->commit = now;
+		}
+	}
+}
+
+/* Called when an output starts rendering a frame */
+void
+latency_render(struct cg_server *server) {
+	struct cg_latency *latency = server->latency;
+	if(latency == NULL || latency->pending_mask == 0) {
+		return;
+	}
+	uint64_t now = 0;
+	for(int i = 0; i < CG_LATENCY_SOURCES; ++i) {
+		struct cg_latency_pending *pending = &latency->tracks[i].pending;
+		if(latency->pending_mask & (1u << i) && pending->render == 0) {
+			now = now != 0 ? now : monotonic_ns();
+			pending->render = now;
+		}
+	}
+}
+
+static uint32_t
+stage_latency(uint64_t input, uint64_t stage) {
+	if(stage == 0) {
+		return LATENCY_NONE;
+	}
+	uint64_t us = (stage - input) / 1000;
+	return us < LATENCY_NONE ? us : LATENCY_NONE - 1;
+}
+
+/* Called when an output presented a frame at when, completing the
+ * measurement of all pending inputs for which a frame was rendered. Inputs
+ * waiting for a frame stay pending, so that a frame presented before they
+ * were handled does not complete them. */
+void
+latency_present(struct cg_server *server, const struct timespec *when) {
+	struct cg_latency *latency = server->latency;
+	if(latency == NULL || latency->pending_mask == 0) {
+		return;
+	}
+	uint64_t presented = when != NULL ? timespec_to_ns(when) : monotonic_ns();
+	for(int i = 0; i < CG_LATENCY_SOURCES; ++i) {
+		if(!(latency->pending_mask & (1u << i))) {
+			continue;
+		}
+		struct cg_latency_track *track = &latency->tracks[i];
+		struct cg_latency_pending *pending = &track->pending;
+		if(presented < pending->input ||
+		   presented - pending->input > LATENCY_MAX_AGE_NS) {
+			latency->pending_mask &= ~(1u << i);
+			continue;
+		}
+		if(pending->render == 0) {
+			continue;
+		}
+		struct cg_latency_sample *sample =
+		    &track->samples[track->nsamples++ % LATENCY_SAMPLES];
+		sample->commit = stage_latency(pending->input, pending->commit);
+		sample->render = stage_latency(pending->input, pending->render);
+		sample->present = stage_latency(pending->input, presented);
+		latency->pending_mask &= ~(1u << i);
+	}
+}
+
+static int
+compare_uint32(const void *a, const void *b) {
+	uint32_t ua = *(const uint32_t *)a, ub = *(const uint32_t *)b;
+	return ua < ub ? -1 : ua > ub;
+}
+
+/* Prints the percentiles of one stage of the samples in milliseconds */
+static void
+print_stage(FILE *stream, const char *name,
+            const struct cg_latency_sample *samples, size_t nsamples,
+            size_t offset, uint32_t *values) {
+	size_t n = 0;
+	for(size_t i = 0; i < nsamples; ++i) {
+		uint32_t value =
+		    *(const uint32_t *)((const char *)&samples[i] + offset);
+		if(value != LATENCY_NONE) {
+			values[n++] = value;
+		}
+	}
+	fprintf(stream, "\"%s\":{\"samples\":%zu", name, n);
+	if(n > 0) {
+		qsort(values, n, sizeof(uint32_t), compare_uint32);
+		const int percentiles[] = {50, 90, 99};
+		for(size_t i = 0; i < sizeof(percentiles) / sizeof(int); ++i) {
+			size_t index = (n * percentiles[i] + 99) / 100 - 1;
+			fprintf(stream, ",\"p%d\":%.3f", percentiles[i],
+			        values[index] / 1000.0);
+		}
+		fprintf(stream, ",\"max\":%.3f", values[n - 1] / 1000.0);
+	}
+	fprintf(stream, "}");
+}
+
+static char *
+latency_to_json(const struct cg_latency *latency, size_t *length) {
+	uint32_t *values = malloc(LATENCY_SAMPLES * sizeof(uint32_t));
+	if(values == NULL) {
+		return NULL;
+	}
+	char *json = NULL;
+	FILE *stream = open_memstream(&json, length);
+	if(stream == NULL) {
+		free(values);
+		return NULL;
+	}
+	fprintf(stream, "{");
+	for(int i = 0; i < CG_LATENCY_SOURCES; ++i) {
+		const struct cg_latency_track *track = &latency->tracks[i];
+		size_t nsamples = track->nsamples < LATENCY_SAMPLES ? track->nsamples
+		                                                    : LATENCY_SAMPLES;
+		fprintf(stream, "%s\"%s\":{", i == 0 ? "" : ",", source_names[i]);
+		print_stage(stream, "commit", track->samples, nsamples,
+		            offsetof(struct cg_latency_sample, commit), values);
+		fprintf(stream, ",");
+		print_stage(stream, "render", track->samples, nsamples,
+		            offsetof(struct cg_latency_sample, render), values);
+		fprintf(stream, ",");
+		print_stage(stream, "present", track->samples, nsamples,
+		            offsetof(struct cg_latency_sample, present), values);
+		fprintf(stream, "}");
+	}
+	fprintf(stream, "}\n");
+	free(values);
+	if(fclose(stream) != 0) {
+		free(json);
+		return NULL;
+	}
+	return json;
+}
+
+/* Dumps the latency percentiles of the recent input events as JSON through
+ * ipc_send_result */
+int
+latency_dump(struct cg_server *server, const char *path) {
+	if(server->latency == NULL) {
+		wlr_log(WLR_ERROR, "No latency statistics available");
+		return -1;
+	}
+	size_t length;
+	char *json = latency_to_json(server->latency, &length);
+	if(json == NULL) {
+		wlr_log(WLR_ERROR, "Failed to serialize latency statistics");
+		return -1;
+	}
+	int ret = ipc_send_result(server, path, json, length);
+	free(json);
+	return ret;
+}
@@ -0,0 +1,32 @@
+#ifndef CG_LATENCY_H
+#define CG_LATENCY_H
+
+#include <stdint.h>
+
+struct cg_server;
+struct timespec;
+
+enum cg_latency_source {
+	CG_LATENCY_KEY,
+	CG_LATENCY_BUTTON,
+	CG_LATENCY_MOTION,
+	CG_LATENCY_SOURCES,
+};
+
+int
+latency_init(struct cg_server *server);
+void
+latency_fini(struct cg_server *server);
+void
+latency_input(struct cg_server *server, enum cg_latency_source source,
+              uint32_t time_msec);
+void
+latency_commit(struct cg_server *server);
+void
+latency_render(struct cg_server *server);
+void
+latency_present(struct cg_server *server, const struct timespec *when);
+int
+latency_dump(struct cg_server *server, const char *path);
+
+#endif
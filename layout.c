@@ -0,0 +1,558 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+/* Layout files describe the tiles of every workspace in use, one line per
+ * item:
+ *
+ *   layout 1
+ *   output <name> <width> <height>
+ *   workspace <n>
+ *   tile <x> <y> <width> <height> [app_id <app id> | title <title>]
+ *
+ * The first tile of a workspace is its focused tile. The optional rule of a
+ * tile names the view which should be shown in it. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/log.h>
+
+#include "ipc_server.h"
+#include "layout.h"
+#include "output.h"
+#include "pool.h"
+#include "seat.h"
+#include "server.h"
+#include "view.h"
+#include "workspace.h"
+
+#define LAYOUT_VERSION 1
+
+/* A tile as read from a layout file, in the coordinates of the output at the
+ * time it was dumped */
+struct layout_tile {
+	struct wlr_box box;
+	char *app_id_rule;
+	char *title_rule;
+};
+
+/* A workspace as read from a layout file */
+struct layout_workspace {
+	struct cg_output *output; // NULL if the output is not connected
+	int width, height;        // Size of the output when dumped
+	uint32_t index;
+	bool skip; // The workspace cannot be restored
+	struct layout_tile *tiles;
+	uint32_t ntiles;
+	uint32_t capacity;
+};
+
+static bool
+is_printable_rule(const char *rule) {
+	return rule != NULL && *rule != '\0' && strchr(rule, '\n') == NULL;
+}
+
+static void
+dump_rule(FILE *file, const struct cg_tile *tile) {
+	const char *app_id = tile->app_id_rule, *title = tile->title_rule;
+	if(tile->view != NULL) {
+		app_id = view_get_app_id(tile->view);
+		title = tile->view->impl->get_title(tile->view);
+	}
+	if(is_printable_rule(app_id)) {
+		fprintf(file, " app_id %s", app_id);
+	} else if(is_printable_rule(title)) {
+		fprintf(file, " title %s", title);
+	}
+}
+
+/* Dumps the tiles of all workspaces in use through ipc_send_result */
+int
+layout_dump(struct cg_server *server, const char *path) {
+	char *layout = NULL;
+	size_t length;
+	FILE *file = open_memstream(&layout, &length);
+	if(file == NULL) {
+		wlr_log(WLR_ERROR, "Could not allocate the layout: %s",
+		        strerror(errno));
+		return -1;
+	}
+	fprintf(file, "layout %d\n", LAYOUT_VERSION);
+
+	struct cg_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct wlr_box *output_box = wlr_output_layout_get_box(
+		    server->output_layout, output->wlr_output);
+		if(output->workspaces == NULL || output_box == NULL) {
+			continue;
+		}
+		fprintf(file, "output %s %d %d\n", output->wlr_output->name,
+		        output_box->width, output_box->height);
+		for(uint32_t i = 0; i < server->nws; ++i) {
+			struct cg_workspace *ws = output->workspaces[i];
+			if(ws == NULL) {
+				continue;
+			}
+			fprintf(file, "workspace %u\n", i + 1);
+			struct cg_tile *tile = ws->focused_tile;
+			do {
+				fprintf(file, "tile %d %d %d %d", tile->tile.x, tile->tile.y,
+				        tile->tile.width, tile->tile.height);
+				dump_rule(file, tile);
+				fputc('\n', file);
+				tile = tile->next;
+			} while(tile != ws->focused_tile);
+		}
+	}
+
+	bool failed = ferror(file);
+	if(fclose(file) != 0 || failed) {
+		wlr_log(WLR_ERROR, "Could not serialize the layout");
+		free(layout);
+		return -1;
+	}
+	int ret = ipc_send_result(server, path, layout, length);
+	free(layout);
+	return ret;
+}
+
+static void
+tile_clear_rule(struct cg_tile *tile) {
+	free(tile->app_id_rule);
+	free(tile->title_rule);
+	tile->app_id_rule = NULL;
+	tile->title_rule = NULL;
+}
+
+static bool
+tile_rule_matches(const struct cg_tile *tile, const struct cg_view *view) {
+	if(tile->app_id_rule != NULL) {
+		const char *app_id = view_get_app_id(view);
+		return app_id != NULL && strcmp(app_id, tile->app_id_rule) == 0;
+	}
+	if(tile->title_rule != NULL) {
+		const char *title = view->impl->get_title(view);
+		return title != NULL && strcmp(title, tile->title_rule) == 0;
+	}
+	return false;
+}
+
+/* Returns the tile of ws whose rule matches view and consumes the rule, or
+ * NULL if there is none */
+struct cg_tile *
+layout_match_view(struct cg_workspace *ws, const struct cg_view *view) {
+	if(ws->tile_rules == 0) {
+		return NULL;
+	}
+	struct cg_tile *tile = ws->focused_tile;
+	do {
+		if(tile_rule_matches(tile, view)) {
+			tile_clear_rule(tile);
+			--ws->tile_rules;
+			return tile;
+		}
+		tile = tile->next;
+	} while(tile != ws->focused_tile);
+	return NULL;
+}
+
+static void
+layout_workspace_reset(struct layout_workspace *lws) {
+	for(uint32_t i = 0; i < lws->ntiles; ++i) {
+		free(lws->tiles[i].app_id_rule);
+		free(lws->tiles[i].title_rule);
+	}
+	lws->ntiles = 0;
+	lws->skip = true;
+}
+
+/* Scales a coordinate from an output of size from to one of size to. Edges
+ * are scaled rather than sizes, so that adjacent tiles stay adjacent. */
+static int
+scale_edge(int coord, int from, int to) {
+	if(from <= 0 || from == to) {
+		return coord;
+	}
+	return (int)((int64_t)coord * to / from);
+}
+
+/* Returns whether the tiles cover the output box exactly */
+static bool
+tiles_cover_output(const struct layout_tile *tiles, uint32_t ntiles,
+                   const struct wlr_box *output_box) {
+	int64_t area = 0;
+	for(uint32_t i = 0; i < ntiles; ++i) {
+		const struct wlr_box *box = &tiles[i].box;
+		if(box->x < 0 || box->y < 0 || box->width <= 0 || box->height <= 0 ||
+		   box->x + box->width > output_box->width ||
+		   box->y + box->height > output_box->height) {
+			return false;
+		}
+		for(uint32_t j = 0; j < i; ++j) {
+			struct wlr_box overlap;
+			if(wlr_box_intersection(&overlap, box, &tiles[j].box)) {
+				return false;
+			}
+		}
+		area += (int64_t)box->width * box->height;
+	}
+	return area == (int64_t)output_box->width * output_box->height;
+}
+
+/* Replaces the tiles of the workspace described by lws and lays out its views
+ * once. Views already mapped are placed according to the tile rules, the
+ * remaining tiles are filled with the views shown before. */
+static void
+layout_apply_workspace(struct cg_server *server, struct layout_workspace *lws) {
+	struct cg_output *output = lws->output;
+	if(lws->skip || output == NULL || lws->ntiles == 0) {
+		return;
+	}
+	struct wlr_box *output_box =
+	    wlr_output_layout_get_box(server->output_layout, output->wlr_output);
+	if(output_box == NULL) {
+		return;
+	}
+	for(uint32_t i = 0; i < lws->ntiles; ++i) {
+		struct wlr_box *box = &lws->tiles[i].box;
+		int x2 = scale_edge(box->x + box->width, lws->width, output_box->width);
+		int y2 =
+		    scale_edge(box->y + box->height, lws->height, output_box->height);
+		box->x = scale_edge(box->x, lws->width, output_box->width);
+		box->y = scale_edge(box->y, lws->height, output_box->height);
+		box->width = x2 - box->x;
+		box->height = y2 - box->y;
+	}
+	if(!tiles_cover_output(lws->tiles, lws->ntiles, output_box)) {
+		wlr_log(WLR_ERROR,
+		        "Tiles of workspace %u do not cover output \"%s\", not "
+		        "restoring it",
+		        lws->index + 1, output->wlr_output->name);
+		return;
+	}
+	struct cg_workspace *ws = output_get_workspace(output, lws->index);
+	if(ws == NULL) {
+		return;
+	}
+
+	/* Remember the views currently shown, focused one first */
+	uint32_t nshown = 0;
+	struct cg_tile *tile = ws->focused_tile;
+	do {
+		nshown += tile->view != NULL;
+		tile = tile->next;
+	} while(tile != ws->focused_tile);
+	struct cg_view **shown = NULL;
+	if(nshown > 0) {
+		shown = malloc(nshown * sizeof(struct cg_view *));
+		if(shown == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate memory to restore layout");
+			return;
+		}
+		nshown = 0;
+		do {
+			if(tile->view != NULL) {
+				shown[nshown++] = tile->view;
+			}
+			tile = tile->next;
+		} while(tile != ws->focused_tile);
+	}
+
+	struct cg_tile *first = NULL;
+	for(uint32_t i = 0; i < lws->ntiles; ++i) {
+		tile = pool_alloc(&server->tile_pool);
+		if(tile == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate tiles to restore layout");
+			if(first != NULL) {
+				first->prev->next = NULL;
+				while(first != NULL) {
+					struct cg_tile *next = first->next;
+					free(first->app_id_rule);
+					free(first->title_rule);
+					pool_free(&server->tile_pool, first);
+					first = next;
+				}
+			}
+			free(shown);
+			return;
+		}
+		tile->workspace = ws;
+		tile->tile = lws->tiles[i].box;
+		tile->app_id_rule = lws->tiles[i].app_id_rule;
+		tile->title_rule = lws->tiles[i].title_rule;
+		lws->tiles[i].app_id_rule = NULL;
+		lws->tiles[i].title_rule = NULL;
+		if(first == NULL) {
+			first = tile->next = tile->prev = tile;
+		} else {
+			tile->prev = first->prev;
+			tile->next = first;
+			first->prev->next = tile;
+			first->prev = tile;
+		}
+	}
+
+	workspace_free_tiles(ws);
+	ws->focused_tile = first;
+
+	struct cg_view *view;
+	wl_list_for_each(view, &ws->views, link) {
+		view->tile = first;
+	}
+
+	/* Place views matching a rule */
+	tile = first;
+	do {
+		if(tile->app_id_rule != NULL || tile->title_rule != NULL) {
+			wl_list_for_each(view, &ws->views, link) {
+				if(!view_is_visible(view) && tile_rule_matches(tile, view)) {
+					tile->view = view;
+					view->tile = tile;
+					tile_clear_rule(tile);
+					break;
+				}
+			}
+			if(tile->view == NULL) {
+				++ws->tile_rules;
+			}
+		}
+		tile = tile->next;
+	} while(tile != first);
+
+	/* Fill the tiles without rules with the views shown before */
+	uint32_t next_shown = 0;
+	tile = first;
+	do {
+		if(tile->view == NULL && tile->app_id_rule == NULL &&
+		   tile->title_rule == NULL) {
+			while(next_shown < nshown && view_is_visible(shown[next_shown])) {
+				++next_shown;
+			}
+			if(next_shown < nshown) {
+				tile->view = shown[next_shown++];
+				tile->view->tile = tile;
+			}
+		}
+		tile = tile->next;
+	} while(tile != first);
+	free(shown);
+
+	tile = first;
+	do {
+		if(tile->view != NULL) {
+			view_maximize(tile->view, tile);
+		}
+		tile = tile->next;
+	} while(tile != first);
+	wl_list_for_each(view, &ws->views, link) {
+		view_update_hidden(view);
+	}
+	workspace_update_neighbours(ws);
+
+	if(output->workspaces[output->curr_workspace] == ws) {
+		wlr_output_damage_add_whole(output->damage);
+		if(output == server->curr_output) {
+			seat_set_focus(server->seat, first->view);
+		}
+	}
+}
+
+static struct cg_output *
+output_from_name(struct cg_server *server, const char *name) {
+	struct cg_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if(strcmp(output->wlr_output->name, name) == 0) {
+			return output;
+		}
+	}
+	return NULL;
+}
+
+static int
+parse_tile(struct layout_workspace *lws, char *saveptr) {
+	if(lws->ntiles == lws->capacity) {
+		uint32_t capacity = lws->capacity > 0 ? 2 * lws->capacity : 8;
+		struct layout_tile *tiles =
+		    realloc(lws->tiles, capacity * sizeof(struct layout_tile));
+		if(tiles == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate memory to restore layout");
+			return -1;
+		}
+		lws->tiles = tiles;
+		lws->capacity = capacity;
+	}
+	struct layout_tile *tile = &lws->tiles[lws->ntiles];
+	int *coords[] = {&tile->box.x, &tile->box.y, &tile->box.width,
+	                 &tile->box.height};
+	for(int i = 0; i < 4; ++i) {
+		char *str = strtok_r(NULL, " ", &saveptr), *end;
+		if(str == NULL) {
+			return -1;
+		}
+		long val = strtol(str, &end, 10);
+		if(*end != '\0' || val < 0 || val > INT32_MAX) {
+			return -1;
+		}
+		*coords[i] = val;
+	}
+	tile->app_id_rule = NULL;
+	tile->title_rule = NULL;
+	char *kind = strtok_r(NULL, " ", &saveptr);
+	if(kind != NULL) {
+		if(saveptr == NULL || *saveptr == '\0') {
+			return -1;
+		}
+		if(strcmp(kind, "app_id") == 0) {
+			tile->app_id_rule = strdup(saveptr);
+		} else if(strcmp(kind, "title") == 0) {
+			tile->title_rule = strdup(saveptr);
+		} else {
+			return -1;
+		}
+		if(tile->app_id_rule == NULL && tile->title_rule == NULL) {
+			return -1;
+		}
+	}
+	++lws->ntiles;
+	return 0;
+}
+
+/* Appends an empty workspace record to workspaces, returns it or NULL if
+ * memory could not be allocated */
+static struct layout_workspace *
+layout_add_workspace(struct layout_workspace **workspaces,
+                     uint32_t *nworkspaces, uint32_t *capacity) {
+	if(*nworkspaces == *capacity) {
+		uint32_t new_capacity = *capacity > 0 ? 2 * *capacity : 8;
+		struct layout_workspace *new_workspaces = realloc(
+		    *workspaces, new_capacity * sizeof(struct layout_workspace));
+		if(new_workspaces == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate memory to restore layout");
+			return NULL;
+		}
+		*workspaces = new_workspaces;
+		*capacity = new_capacity;
+	}
+	struct layout_workspace *lws = &(*workspaces)[(*nworkspaces)++];
+	*lws = (struct layout_workspace){.skip = true};
+	return lws;
+}
+
+/* Restores the tiles of all workspaces in the layout file at path. Workspaces
+ * of outputs which are not connected are ignored. The whole file is parsed
+ * before any workspace is changed, so that an invalid file leaves the layout
+ * untouched. */
+int
+layout_restore(struct cg_server *server, const char *path) {
+	FILE *file = fopen(path, "r");
+	if(file == NULL) {
+		wlr_log(WLR_ERROR, "Could not open layout \"%s\": %s", path,
+		        strerror(errno));
+		return -1;
+	}
+
+	struct layout_workspace *workspaces = NULL;
+	uint32_t nworkspaces = 0, capacity = 0;
+	/* Record the tiles are added to, tiles following an output line but no
+	 * workspace line go to a record which is skipped */
+	struct layout_workspace *lws = NULL;
+	struct cg_output *output = NULL;
+	int width = 0, height = 0;
+	char *line = NULL;
+	size_t line_size = 0;
+	unsigned int line_num = 0;
+	int ret = 0;
+	while(getline(&line, &line_size, file) != -1) {
+		++line_num;
+		line[strcspn(line, "\n")] = '\0';
+		char *saveptr = NULL;
+		char *keyword = strtok_r(line, " ", &saveptr);
+		if(line_num == 1) {
+			char *version = strtok_r(NULL, " ", &saveptr);
+			if(keyword == NULL || strcmp(keyword, "layout") != 0 ||
+			   version == NULL || atoi(version) != LAYOUT_VERSION) {
+				wlr_log(WLR_ERROR, "\"%s\" is not a layout of version %d",
+				        path, LAYOUT_VERSION);
+				ret = -1;
+				break;
+			}
+			continue;
+		}
+		if(keyword == NULL) {
+			continue;
+		}
+
+		if(strcmp(keyword, "output") == 0) {
+			char *name = strtok_r(NULL, " ", &saveptr);
+			char *width_str = strtok_r(NULL, " ", &saveptr);
+			char *height_str = strtok_r(NULL, " ", &saveptr);
+			if(name == NULL || width_str == NULL || height_str == NULL) {
+				ret = -1;
+				break;
+			}
+			output = output_from_name(server, name);
+			width = atoi(width_str);
+			height = atoi(height_str);
+			lws = layout_add_workspace(&workspaces, &nworkspaces, &capacity);
+			if(lws == NULL) {
+				ret = -1;
+				break;
+			}
+		} else if(strcmp(keyword, "workspace") == 0) {
+			char *index_str = strtok_r(NULL, " ", &saveptr);
+			if(lws == NULL || index_str == NULL) {
+				ret = -1;
+				break;
+			}
+			long index = strtol(index_str, NULL, 10);
+			lws = layout_add_workspace(&workspaces, &nworkspaces, &capacity);
+			if(lws == NULL) {
+				ret = -1;
+				break;
+			}
+			lws->output = output;
+			lws->width = width;
+			lws->height = height;
+			lws->index = index - 1;
+			lws->skip = index < 1 || index > server->nws;
+		} else if(strcmp(keyword, "tile") == 0) {
+			if(lws == NULL || parse_tile(lws, saveptr) != 0) {
+				ret = -1;
+				break;
+			}
+		} else {
+			ret = -1;
+			break;
+		}
+	}
+	if(ret == 0) {
+		for(uint32_t i = 0; i < nworkspaces; ++i) {
+			layout_apply_workspace(server, &workspaces[i]);
+		}
+	} else if(line_num > 1) {
+		wlr_log(WLR_ERROR, "Error parsing line %u of layout \"%s\"", line_num,
+		        path);
+	}
+	for(uint32_t i = 0; i < nworkspaces; ++i) {
+		layout_workspace_reset(&workspaces[i]);
+		free(workspaces[i].tiles);
+	}
+	free(workspaces);
+	free(line);
+	fclose(file);
+	return ret;
+}
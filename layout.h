@@ -0,0 +1,16 @@
+#ifndef CG_LAYOUT_H
+#define CG_LAYOUT_H
+
+struct cg_server;
+struct cg_tile;
+struct cg_view;
+struct cg_workspace;
+
+int
+layout_dump(struct cg_server *server, const char *path);
+int
+layout_restore(struct cg_server *server, const char *path);
+struct cg_tile *
+layout_match_view(struct cg_workspace *ws, const struct cg_view *view);
+
+#endif
@@ -1,6 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <cairo/cairo.h>
 #include <drm_fourcc.h>
+#include <errno.h>
 #include <pango/pangocairo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <wlr/backend.h>
 #include <wlr/render/wlr_renderer.h>
@@ -31,14 +39,54 @@ to_cairo_subpixel_order(const enum wl_output_subpixel subpixel) {
 	return CAIRO_SUBPIXEL_ORDER_DEFAULT;
 }
 
-struct wlr_texture *
-create_message_texture(const char *string, const struct cg_output *output) {
+/* A message handed to the rasterization worker. The input fields are set by
+ * the main thread before the job is queued and the result fields are only
+ * written by the worker. Ownership passes back to the main thread once the job
+ * is on the done queue. */
+struct cg_message_job {
+	/* Input */
+	char *text;
+	double scale;
+	enum wl_output_subpixel subpixel;
+
+	/* Result */
+	unsigned char *pixels;
+	int width;
+	int height;
+	int stride;
+
+	/* Main thread only */
+	struct cg_output *output; // NULL if the message was cleared meanwhile
+	struct wlr_box position;
+	enum cg_message_align align;
+	struct wl_list link; // cg_output::raster_jobs
+
+	struct cg_message_job *next; // Protected by cg_message_worker::lock
+};
+
+struct cg_message_worker {
+	struct cg_server *server;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool stop;
+	struct cg_message_job *queue_head, *queue_tail;
+	struct cg_message_job *done_head, *done_tail;
+
+	int event_fd; // Signals the main loop that jobs are done
+	struct wl_event_source *event_source;
+};
+
+/* Renders string into a newly allocated ARGB32 buffer. This does not touch
+ * any compositor state and may be called from the worker thread. */
+static unsigned char *
+rasterize_message(const char *string, double scale,
+                  enum wl_output_subpixel subpixel, int *width_out,
+                  int *height_out, int *stride_out) {
 	const int WIDTH_PADDING = 8;
 	const int HEIGHT_PADDING = 2;
 	const char *font = "pango:Monospace 10";
 
-	struct wlr_texture *texture;
-	double scale = output->wlr_output->scale;
 	int width = 0;
 	int height = 0;
 
@@ -57,8 +105,8 @@ create_message_texture(const char *string, const struct cg_output *output) {
 	cairo_font_options_t *fo = cairo_font_options_create();
 	cairo_font_options_set_hint_style(fo, CAIRO_HINT_STYLE_FULL);
 	cairo_font_options_set_antialias(fo, CAIRO_ANTIALIAS_SUBPIXEL);
-	cairo_font_options_set_subpixel_order(
-	    fo, to_cairo_subpixel_order(output->wlr_output->subpixel));
+	cairo_font_options_set_subpixel_order(fo,
+	                                      to_cairo_subpixel_order(subpixel));
 	cairo_set_font_options(c, fo);
 	get_text_size(c, font, &width, &height, NULL, scale, "%s", string);
 	width += 2 * WIDTH_PADDING;
@@ -66,8 +114,14 @@ create_message_texture(const char *string, const struct cg_output *output) {
 	cairo_surface_destroy(dummy_surface);
 	cairo_destroy(c);
 
-	cairo_surface_t *surface =
-	    cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+	unsigned char *pixels = calloc(height, stride);
+	if(pixels == NULL) {
+		cairo_font_options_destroy(fo);
+		return NULL;
+	}
+	cairo_surface_t *surface = cairo_image_surface_create_for_data(
+	    pixels, CAIRO_FORMAT_ARGB32, width, height, stride);
 	cairo_t *cairo = cairo_create(surface);
 	cairo_set_antialias(cairo, CAIRO_ANTIALIAS_BEST);
 	cairo_set_font_options(cairo, fo);
@@ -84,68 +138,495 @@ create_message_texture(const char *string, const struct cg_output *output) {
 	pango_printf(cairo, font, scale, "%s", string);
 
 	cairo_surface_flush(surface);
-	unsigned char *data = cairo_image_surface_get_data(surface);
-	int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
-	texture =
-	    wlr_texture_from_pixels(output->server->renderer, DRM_FORMAT_ARGB8888,
-	                            stride, width, height, data);
 	cairo_surface_destroy(surface);
 	g_object_unref(pango);
 	cairo_destroy(cairo);
-	return texture;
+
+	*width_out = width;
+	*height_out = height;
+	*stride_out = stride;
+	return pixels;
+}
+
+/* The overlay covers the bounding box of the messages on screen, so that it
+ * can be drawn at once. Its texture starts out this large and doubles in
+ * either dimension when the box outgrows it. */
+#define OVERLAY_MIN_WIDTH 512
+#define OVERLAY_MIN_HEIGHT 64
+
+/* Copies the part of message inside clip (or all of it if clip is NULL) to
+ * its position in the overlay */
+static void
+overlay_write(struct cg_output *output, const struct cg_message *message,
+              const struct wlr_box *clip) {
+	struct wlr_box area;
+	if(!wlr_box_intersection(&area, &message->position, &output->overlay_box)) {
+		return;
+	}
+	if(clip != NULL && !wlr_box_intersection(&area, &area, clip)) {
+		return;
+	}
+	if(!wlr_texture_write_pixels(
+	       output->overlay, message->stride, area.width, area.height,
+	       area.x - message->position.x, area.y - message->position.y,
+	       area.x - output->overlay_box.x, area.y - output->overlay_box.y,
+	       message->pixels)) {
+		wlr_log(WLR_ERROR, "Failed to update message overlay");
+	}
+}
+
+/* Makes the overlay cover the bounding box of all messages of output, inside
+ * the output, growing its texture if needed, and writes them to it */
+static bool
+overlay_rebuild(struct cg_output *output) {
+	struct wlr_box bounds = {0};
+	wlr_output_transformed_resolution(output->wlr_output, &bounds.width,
+	                                  &bounds.height);
+	int x1 = bounds.width, y1 = bounds.height, x2 = 0, y2 = 0;
+	struct cg_message *message;
+	wl_list_for_each(message, &output->messages, link) {
+		struct wlr_box area;
+		if(!wlr_box_intersection(&area, &message->position, &bounds)) {
+			continue;
+		}
+		x1 = area.x < x1 ? area.x : x1;
+		y1 = area.y < y1 ? area.y : y1;
+		x2 = area.x + area.width > x2 ? area.x + area.width : x2;
+		y2 = area.y + area.height > y2 ? area.y + area.height : y2;
+	}
+	if(x2 <= x1 || y2 <= y1) {
+		/* Nothing is on screen */
+		output->overlay_box = (struct wlr_box){0};
+		return true;
+	}
+	output->overlay_box =
+	    (struct wlr_box){.x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1};
+
+	int width = OVERLAY_MIN_WIDTH, height = OVERLAY_MIN_HEIGHT;
+	if(output->overlay != NULL) {
+		width = (int)output->overlay->width;
+		height = (int)output->overlay->height;
+	}
+	while(width < output->overlay_box.width) {
+		width *= 2;
+	}
+	while(height < output->overlay_box.height) {
+		height *= 2;
+	}
+	if(output->overlay == NULL || width != (int)output->overlay->width ||
+	   height != (int)output->overlay->height) {
+		if(output->overlay != NULL) {
+			wlr_texture_destroy(output->overlay);
+			output->overlay = NULL;
+		}
+		unsigned char *blank = calloc(height, width * 4);
+		if(blank == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate message overlay");
+			return false;
+		}
+		output->overlay = wlr_texture_from_pixels(
+		    output->server->renderer, DRM_FORMAT_ARGB8888, width * 4, width,
+		    height, blank);
+		free(blank);
+		if(output->overlay == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create message overlay");
+			return false;
+		}
+	}
+	wl_list_for_each_reverse(message, &output->messages, link) {
+		overlay_write(output, message, NULL);
+	}
+	return true;
+}
+
+/* Copies the pixels of a new message into the overlay, moving the overlay
+ * if the message lies outside of it. Only the boxes of the messages are
+ * drawn, so what is left around them in the overlay does not matter. */
+static bool
+overlay_add(struct cg_output *output, struct cg_message *message) {
+	struct wlr_box area;
+	if(output->overlay != NULL &&
+	   wlr_box_intersection(&area, &message->position, &output->overlay_box) &&
+	   area.width == message->position.width &&
+	   area.height == message->position.height) {
+		overlay_write(output, message, NULL);
+		return true;
+	}
+	return overlay_rebuild(output);
+}
+
+/* Redraws the messages which overlapped a removed one, oldest first */
+static void
+overlay_remove(struct cg_output *output, const struct wlr_box *box) {
+	if(output->overlay == NULL) {
+		return;
+	}
+	struct cg_message *message;
+	wl_list_for_each_reverse(message, &output->messages, link) {
+		overlay_write(output, message, box);
+	}
+}
+
+struct wlr_texture *
+message_overlay_texture(struct cg_output *output) {
+	if(wl_list_empty(&output->messages) ||
+	   wlr_box_empty(&output->overlay_box)) {
+		return NULL;
+	}
+	return output->overlay;
+}
+
+/* Frees the overlay, which is otherwise kept while the output exists so that
+ * clearing and showing messages does not recreate it */
+void
+message_overlay_destroy(struct cg_output *output) {
+	if(output->overlay != NULL) {
+		wlr_texture_destroy(output->overlay);
+		output->overlay = NULL;
+	}
+	output->overlay_box = (struct wlr_box){0};
+}
+
+static void
+message_destroy(struct cg_message *message) {
+	struct cg_output *output = message->output;
+	wl_list_remove(&message->link);
+	wlr_output_damage_add_box(output->damage, &message->position);
+	overlay_remove(output, &message->position);
+	if(message->expiry != NULL) {
+		wl_event_source_remove(message->expiry);
+	}
+	free(message->pixels);
+	pool_free(&output->server->message_pool, message);
+}
+
+static int
+handle_message_expiry(void *data) {
+	message_destroy(data);
+	return 0;
 }
 
 #if CG_HAS_FANALYZE
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 #endif
-void
-message_set_output(struct cg_output *output, const char *string,
-                   struct wlr_box *box, enum cg_message_align align) {
-	struct cg_message *message = malloc(sizeof(struct cg_message));
+/* Shows the rasterized message anchored at box on output, taking ownership of
+ * pixels */
+static void
+message_add(struct cg_output *output, unsigned char *pixels, int width,
+            int height, int stride, const struct wlr_box *box,
+            enum cg_message_align align) {
+	struct cg_message *message = pool_alloc(&output->server->message_pool);
 	if(!message) {
 		wlr_log(WLR_ERROR, "Error allocating message structure");
-		free(box);
+		free(pixels);
 		return;
 	}
-	message->message = create_message_texture(string, output);
-	if(!message->message) {
-		wlr_log(WLR_ERROR, "Could not create message texture");
-		free(box);
-		free(message);
-		return;
+	message->pixels = pixels;
+	message->stride = stride;
+	message->position = *box;
+	message->output = output;
+	message->expiry = NULL;
+	if(output->server->message_timeout > 0) {
+		message->expiry = wl_event_loop_add_timer(
+		    output->server->event_loop, handle_message_expiry, message);
+		if(message->expiry == NULL ||
+		   wl_event_source_timer_update(
+		       message->expiry, output->server->message_timeout * 1000) < 0) {
+			wlr_log(WLR_ERROR, "Could not arm message expiry timer");
+		}
 	}
-	message->position = box;
 	wl_list_insert(&output->messages, &message->link);
 
-	int width = message->message->width;
-	int height = message->message->height;
-	message->position->width = width;
-	message->position->height = height;
+	message->position.width = width;
+	message->position.height = height;
 	switch(align) {
 	case CG_MESSAGE_TOP_RIGHT: {
-		message->position->x -= width;
+		message->position.x -= width;
 		break;
 	}
 	case CG_MESSAGE_BOTTOM_LEFT: {
-		message->position->y -= height;
+		message->position.y -= height;
 		break;
 	}
 	case CG_MESSAGE_BOTTOM_RIGHT: {
-		message->position->x -= width;
-		message->position->y -= height;
+		message->position.x -= width;
+		message->position.y -= height;
 		break;
 	}
 	case CG_MESSAGE_CENTER: {
-		message->position->x -= width / 2;
-		message->position->y -= height / 2;
+		message->position.x -= width / 2;
+		message->position.y -= height / 2;
 		break;
 	}
 	case CG_MESSAGE_TOP_LEFT:
 	default:
 		break;
 	}
-	wlr_output_damage_add_box(output->damage, message->position);
+	if(!overlay_add(output, message)) {
+		message_destroy(message);
+		return;
+	}
+	wlr_output_damage_add_box(output->damage, &message->position);
+}
+
+static void
+message_set_output(struct cg_output *output, const char *string,
+                   const struct wlr_box *box, enum cg_message_align align) {
+	int width, height, stride;
+	unsigned char *pixels =
+	    rasterize_message(string, output->wlr_output->scale,
+	                      output->wlr_output->subpixel, &width, &height, &stride);
+	if(!pixels) {
+		wlr_log(WLR_ERROR, "Could not rasterize message");
+		return;
+	}
+	message_add(output, pixels, width, height, stride, box, align);
+}
+
+static void
+message_job_destroy(struct cg_message_job *job) {
+	free(job->text);
+	free(job->pixels);
+	free(job);
+}
+
+static void *
+message_worker_run(void *data) {
+	struct cg_message_worker *worker = data;
+	pthread_mutex_lock(&worker->lock);
+	while(true) {
+		while(!worker->stop && worker->queue_head == NULL) {
+			pthread_cond_wait(&worker->cond, &worker->lock);
+		}
+		if(worker->stop) {
+			break;
+		}
+		struct cg_message_job *job = worker->queue_head;
+		worker->queue_head = job->next;
+		if(worker->queue_head == NULL) {
+			worker->queue_tail = NULL;
+		}
+		pthread_mutex_unlock(&worker->lock);
+
+		job->pixels =
+		    rasterize_message(job->text, job->scale, job->subpixel,
+		                      &job->width, &job->height, &job->stride);
+
+		pthread_mutex_lock(&worker->lock);
+		job->next = NULL;
+		if(worker->done_tail != NULL) {
+			worker->done_tail->next = job;
+		} else {
+			worker->done_head = job;
+		}
+		worker->done_tail = job;
+
+		uint64_t one = 1;
+		if(write(worker->event_fd, &one, sizeof(one)) != sizeof(one)) {
+			wlr_log(WLR_ERROR, "Failed to signal finished message");
+		}
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return NULL;
+}
+
+/* Shows all messages the worker has finished */
+static int
+handle_message_worker_done(int fd, uint32_t mask, void *data) {
+	struct cg_message_worker *worker = data;
+	uint64_t count;
+	if(read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		wlr_log(WLR_ERROR, "Failed to read from message worker eventfd");
+	}
+
+	pthread_mutex_lock(&worker->lock);
+	struct cg_message_job *job = worker->done_head;
+	worker->done_head = worker->done_tail = NULL;
+	pthread_mutex_unlock(&worker->lock);
+
+	while(job != NULL) {
+		struct cg_message_job *next = job->next;
+		struct cg_output *output = job->output;
+		if(output != NULL) {
+			wl_list_remove(&job->link);
+			if(job->pixels != NULL) {
+				message_add(output, job->pixels, job->width, job->height,
+				            job->stride, &job->position, job->align);
+				job->pixels = NULL;
+			} else {
+				wlr_log(WLR_ERROR, "Could not rasterize message");
+			}
+		}
+		message_job_destroy(job);
+		job = next;
+	}
+	return 0;
+}
+
+static void
+message_worker_submit(struct cg_message_worker *worker,
+                      struct cg_output *output, char *text,
+                      const struct wlr_box *box,
+                      enum cg_message_align align) {
+	struct cg_message_job *job = calloc(1, sizeof(struct cg_message_job));
+	if(job == NULL) {
+		wlr_log(WLR_ERROR, "Error allocating message job");
+		free(text);
+		return;
+	}
+	job->text = text;
+	job->scale = output->wlr_output->scale;
+	job->subpixel = output->wlr_output->subpixel;
+	job->output = output;
+	job->position = *box;
+	job->align = align;
+	wl_list_insert(output->raster_jobs.prev, &job->link);
+
+	pthread_mutex_lock(&worker->lock);
+	if(worker->queue_tail != NULL) {
+		worker->queue_tail->next = job;
+	} else {
+		worker->queue_head = job;
+	}
+	worker->queue_tail = job;
+	pthread_cond_signal(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+}
+
+int
+message_worker_init(struct cg_server *server) {
+	struct cg_message_worker *worker =
+	    calloc(1, sizeof(struct cg_message_worker));
+	if(worker == NULL) {
+		wlr_log(WLR_ERROR, "Error allocating message worker");
+		return -1;
+	}
+	worker->server = server;
+	worker->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(worker->event_fd < 0) {
+		wlr_log(WLR_ERROR, "Failed to create eventfd for message worker");
+		free(worker);
+		return -1;
+	}
+	worker->event_source =
+	    wl_event_loop_add_fd(server->event_loop, worker->event_fd,
+	                         WL_EVENT_READABLE, handle_message_worker_done, worker);
+	if(worker->event_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add message worker to event loop");
+		close(worker->event_fd);
+		free(worker);
+		return -1;
+	}
+	pthread_mutex_init(&worker->lock, NULL);
+	pthread_cond_init(&worker->cond, NULL);
+
+	/* Signals are handled by the event loop of the main thread */
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	int ret = pthread_create(&worker->thread, NULL, message_worker_run, worker);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if(ret != 0) {
+		wlr_log(WLR_ERROR, "Failed to start message worker thread");
+		wl_event_source_remove(worker->event_source);
+		close(worker->event_fd);
+		pthread_mutex_destroy(&worker->lock);
+		pthread_cond_destroy(&worker->cond);
+		free(worker);
+		return -1;
+	}
+	server->message_worker = worker;
+	return 0;
+}
+
+void
+message_worker_fini(struct cg_server *server) {
+	struct cg_message_worker *worker = server->message_worker;
+	if(worker == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&worker->lock);
+	worker->stop = true;
+	pthread_cond_signal(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+	pthread_join(worker->thread, NULL);
+
+	struct cg_message_job *lists[] = {worker->queue_head, worker->done_head};
+	for(size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i) {
+		struct cg_message_job *job = lists[i];
+		while(job != NULL) {
+			struct cg_message_job *next = job->next;
+			if(job->output != NULL) {
+				wl_list_remove(&job->link);
+			}
+			message_job_destroy(job);
+			job = next;
+		}
+	}
+
+	wl_event_source_remove(worker->event_source);
+	close(worker->event_fd);
+	pthread_mutex_destroy(&worker->lock);
+	pthread_cond_destroy(&worker->cond);
+	free(worker);
+	server->message_worker = NULL;
+}
+
+/* Queues a message to be rasterized on the next frame of the output. Takes
+ * ownership of text. A message queued for the same anchor and
+ * alignment as an earlier one replaces it or is appended to it, depending on
+ * server->message_coalesce. */
+static void
+message_queue(struct cg_output *output, char *text, const struct wlr_box *box,
+              enum cg_message_align align) {
+	struct cg_message_request *request;
+	wl_list_for_each(request, &output->pending_messages, link) {
+		if(request->align != align || request->position.x != box->x ||
+		   request->position.y != box->y) {
+			continue;
+		}
+		if(output->server->message_coalesce == CG_MESSAGE_COALESCE_MERGE) {
+			char *merged = malloc_vsprintf("%s\n%s", request->text, text);
+			if(merged != NULL) {
+				free(text);
+				text = merged;
+			}
+		}
+		free(request->text);
+		request->text = text;
+		return;
+	}
+
+	request = pool_alloc(&output->server->message_request_pool);
+	if(request == NULL) {
+		wlr_log(WLR_ERROR, "Error allocating message request");
+		free(text);
+		return;
+	}
+	request->text = text;
+	request->position = *box;
+	request->align = align;
+	wl_list_insert(output->pending_messages.prev, &request->link);
+	wlr_output_schedule_frame(output->wlr_output);
+}
+
+void
+message_flush(struct cg_output *output) {
+	struct cg_message_request *request, *tmp;
+	wl_list_for_each_safe(request, tmp, &output->pending_messages, link) {
+		wl_list_remove(&request->link);
+		if(output->server->message_worker != NULL) {
+			message_worker_submit(output->server->message_worker, output,
+			                      request->text, &request->position,
+			                      request->align);
+		} else {
+			message_set_output(output, request->text, &request->position,
+			                   request->align);
+			free(request->text);
+		}
+		pool_free(&output->server->message_request_pool, request);
+	}
 }
 
 void
@@ -159,52 +640,51 @@ message_printf(struct cg_output *output, const char *fmt, ...) {
 		return;
 	}
 
-	struct wlr_box *box = malloc(sizeof(struct wlr_box));
-	if(box == NULL) {
-		wlr_log(WLR_ERROR, "Failed to allocate box in message_printf");
-		free(buffer);
-		return;
-	}
 	struct wlr_box *output_box = wlr_output_layout_get_box(
 	    output->server->output_layout, output->wlr_output);
+	struct wlr_box box = {.x = output_box->width, .y = 0};
 
-	box->x = output_box->width;
-	box->y = 0;
-	box->width = 0;
-	box->height = 0;
-
-	message_set_output(output, buffer, box, CG_MESSAGE_TOP_RIGHT);
-	free(buffer);
-	alarm(output->server->message_timeout);
+	message_queue(output, buffer, &box, CG_MESSAGE_TOP_RIGHT);
 }
 #if CG_HAS_FANALYZE
 #pragma GCC diagnostic pop
 #endif
 
 void
-message_printf_pos(struct cg_output *output, struct wlr_box *position,
+message_printf_pos(struct cg_output *output, const struct wlr_box *position,
                    const enum cg_message_align align, const char *fmt, ...) {
 	uint16_t buf_len = 256;
 	char *buffer = (char *)malloc(buf_len * sizeof(char));
+	if(buffer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate buffer in message_printf_pos");
+		return;
+	}
 	va_list ap;
 
 	va_start(ap, fmt);
 	vsnprintf(buffer, buf_len, fmt, ap);
 	va_end(ap);
 
-	message_set_output(output, buffer, position, align);
-	free(buffer);
-	alarm(output->server->message_timeout);
+	message_queue(output, buffer, position, align);
 }
 
 void
 message_clear(struct cg_output *output) {
 	struct cg_message *message, *tmp;
 	wl_list_for_each_safe(message, tmp, &output->messages, link) {
-		wl_list_remove(&message->link);
-		wlr_output_damage_add_box(output->damage, message->position);
-		wlr_texture_destroy(message->message);
-		free(message->position);
-		free(message);
+		message_destroy(message);
+	}
+	struct cg_message_request *request, *request_tmp;
+	wl_list_for_each_safe(request, request_tmp, &output->pending_messages,
+	                      link) {
+		wl_list_remove(&request->link);
+		free(request->text);
+		pool_free(&output->server->message_request_pool, request);
+	}
+	/* Messages still being rasterized are discarded once they are done */
+	struct cg_message_job *job, *job_tmp;
+	wl_list_for_each_safe(job, job_tmp, &output->raster_jobs, link) {
+		wl_list_remove(&job->link);
+		job->output = NULL;
 	}
 }
@@ -3,9 +3,10 @@
 #define MESSAGE_H
 
 #include <wayland-server-core.h>
+#include <wlr/util/box.h>
 
 struct cg_output;
-struct wlr_box;
+struct cg_server;
 struct wlr_texture;
 
 enum cg_message_align {
@@ -16,25 +17,54 @@ enum cg_message_align {
 	CG_MESSAGE_CENTER,
 };
 
+/* How messages requested for the same position before the next frame are
+ * combined */
+enum cg_message_coalesce {
+	CG_MESSAGE_COALESCE_DROP,  // only the most recent message is shown
+	CG_MESSAGE_COALESCE_MERGE, // the messages are shown line by line
+};
+
 struct cg_message_config {
 	char *font;
 	int display_time;
+	int coalesce; // enum cg_message_coalesce, or -1 if unset
 	float bg_color[4];
 	float fg_color[4];
 };
 
 struct cg_message {
-	struct wlr_box *position;
-	struct wlr_texture *message;
+	struct wlr_box position;
+	unsigned char *pixels; // ARGB32, copied into cg_output::overlay
+	int stride;
+	struct cg_output *output;
+	struct wl_event_source *expiry; // Removes the message once it timed out
 	struct wl_list link;
 };
 
+/* A message which has not been rasterized yet */
+struct cg_message_request {
+	char *text;
+	struct wlr_box position; // Anchor of the message
+	enum cg_message_align align;
+	struct wl_list link; // cg_output::pending_messages
+};
+
 void
 message_printf(struct cg_output *output, const char *fmt, ...);
 void
-message_printf_pos(struct cg_output *output, struct wlr_box *position,
+message_printf_pos(struct cg_output *output, const struct wlr_box *position,
                    enum cg_message_align, const char *fmt, ...);
 void
 message_clear(struct cg_output *output);
+void
+message_flush(struct cg_output *output);
+struct wlr_texture *
+message_overlay_texture(struct cg_output *output);
+void
+message_overlay_destroy(struct cg_output *output);
+int
+message_worker_init(struct cg_server *server);
+void
+message_worker_fini(struct cg_server *server);
 
 #endif /* end of include guard MESSAGE_H */
@@ -34,13 +34,17 @@
 #endif
 
 #include "keybinding.h"
+#include "latency.h"
 #include "message.h"
 #include "output.h"
 #include "render.h"
 #include "seat.h"
 #include "server.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "util.h"
 #include "view.h"
+#include "watchdog.h"
 #include "workspace.h"
 #if CG_HAS_XWAYLAND
 #include "xwayland.h"
@@ -313,6 +317,30 @@ output_damage_surface(struct cg_output *output, struct wlr_surface *surface,
 	                                damage_surface_iterator, &data);
 }
 
+/* Like output_damage_surface, but without the subsurfaces of surface */
+void
+output_damage_single_surface(struct cg_output *output,
+                             struct wlr_surface *surface, double ox, double oy,
+                             bool whole) {
+	if(!wlr_surface_has_buffer(surface)) {
+		return;
+	}
+	struct wlr_box surface_box = {
+	    .x = ox + surface->sx,
+	    .y = oy + surface->sy,
+	    .width = surface->current.width,
+	    .height = surface->current.height,
+	};
+	if(!intersects_with_output(output, output->server->output_layout,
+	                           &surface_box)) {
+		return;
+	}
+	struct damage_data data = {
+	    .whole = whole,
+	};
+	damage_surface_iterator(output, surface, &surface_box, &data);
+}
+
 static void
 handle_output_damage_frame(struct wl_listener *listener, void *data) {
 	struct cg_output *output = wl_container_of(listener, output, damage_frame);
@@ -322,6 +350,12 @@ handle_output_damage_frame(struct wl_listener *listener, void *data) {
 		return;
 	}
 
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(output->server);
+
+	/* Rasterize only the messages which survived until this frame */
+	message_flush(output);
+
 	bool scanned_out = scan_out_primary_view(output);
 
 	if(scanned_out && !output->last_scanned_out_view) {
@@ -367,6 +401,18 @@ damage_finish:
 frame_done:
 	clock_gettime(CLOCK_MONOTONIC, &frame_data.when);
 	send_frame_done(output, &frame_data);
+	watchdog_end(output->server, CG_WATCHDOG_FRAME, watchdog_start);
+	TRACE_END(trace_start, "output.frame");
+}
+
+static void
+handle_output_present(struct wl_listener *listener, void *data) {
+	struct cg_output *output = wl_container_of(listener, output, present);
+	struct wlr_output_event_present *event = data;
+
+	if(event->presented) {
+		latency_present(output->server, event->when);
+	}
 }
 
 static void
@@ -398,6 +444,7 @@ handle_output_mode(struct wl_listener *listener, void *data) {
 		return;
 	}
 
+	uint64_t watchdog_start = watchdog_begin(output->server);
 	struct cg_view *view;
 	wl_list_for_each(view, &output->workspaces[output->curr_workspace]->views,
 	                 link) {
@@ -405,6 +452,7 @@ handle_output_mode(struct wl_listener *listener, void *data) {
 			view_maximize(view, view->tile);
 		}
 	}
+	watchdog_end(output->server, CG_WATCHDOG_OUTPUT, watchdog_start);
 }
 
 void
@@ -415,15 +463,20 @@ output_clear(struct cg_output *output) {
 	if(server->running && server->curr_output == output &&
 	   wl_list_length(&server->outputs) > 1) {
 		keybinding_cycle_outputs(server, false);
+		snapshot_schedule(server);
 	}
 
 	wl_list_remove(&output->link);
 
 	message_clear(output);
+	message_overlay_destroy(output);
 
 	struct cg_view *view, *view_tmp;
 	if(server->running) {
 		for(unsigned int i = 0; i < server->nws; ++i) {
+			if(output->workspaces[i] == NULL) {
+				continue;
+			}
 
 			bool first = true;
 			for(struct cg_tile *tile = output->workspaces[i]->focused_tile;
@@ -435,6 +488,7 @@ output_clear(struct cg_output *output) {
 			wl_list_for_each_safe(view, view_tmp, &output->workspaces[i]->views,
 			                      link) {
 				wl_list_remove(&view->link);
+				view_unqueue_hidden(view);
 				if(wl_list_empty(&server->outputs)) {
 					view->impl->destroy(view);
 				} else {
@@ -453,6 +507,7 @@ output_clear(struct cg_output *output) {
 					if(server->seat->focused_view == NULL) {
 						seat_set_focus(server->seat, view);
 					}
+					view_update_hidden(view);
 				}
 			}
 			wl_list_for_each_safe(
@@ -473,6 +528,7 @@ output_clear(struct cg_output *output) {
 					    server->curr_output
 					        ->workspaces[server->curr_output->curr_workspace]
 					        ->focused_tile;
+					workspace_update_unmanaged_box(view->workspace);
 				}
 			}
 		}
@@ -486,6 +542,7 @@ output_destroy(struct cg_output *output) {
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->mode.link);
 	wl_list_remove(&output->commit.link);
+	wl_list_remove(&output->present.link);
 	wl_list_remove(&output->damage_frame.link);
 	wl_list_remove(&output->damage_destroy.link);
 
@@ -495,7 +552,9 @@ output_destroy(struct cg_output *output) {
 	 * have nothing in common. The former is the workspace of a single output,
 	 * whereas the latter is the workspace of the outputs.*/
 	for(unsigned int i = 0; i < server->nws; ++i) {
-		workspace_free(output->workspaces[i]);
+		if(output->workspaces[i] != NULL) {
+			workspace_free(output->workspaces[i]);
+		}
 	}
 	free(output->workspaces);
 
@@ -638,6 +697,8 @@ handle_new_output(struct wl_listener *listener, void *data) {
 	wl_signal_add(&wlr_output->events.mode, &output->mode);
 	output->commit.notify = handle_output_commit;
 	wl_signal_add(&wlr_output->events.commit, &output->commit);
+	output->present.notify = handle_output_present;
+	wl_signal_add(&wlr_output->events.present, &output->present);
 	output->destroy.notify = handle_output_destroy;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 	output->damage_frame.notify = handle_output_damage_frame;
@@ -650,6 +711,10 @@ handle_new_output(struct wl_listener *listener, void *data) {
 
 	output->curr_workspace = 0;
 	wl_list_init(&output->messages);
+	wl_list_init(&output->pending_messages);
+	wl_list_init(&output->raster_jobs);
+	output->overlay = NULL;
+	output->overlay_box = (struct wlr_box){0};
 
 	if(!wlr_xcursor_manager_load(server->seat->xcursor_manager,
 	                             wlr_output->scale)) {
@@ -662,20 +727,17 @@ handle_new_output(struct wl_listener *listener, void *data) {
 	output_configure(server, output);
 	wlr_output_damage_add_whole(output->damage);
 
-	output->workspaces = malloc(server->nws * sizeof(struct cg_workspace *));
-	for(unsigned int i = 0; i < server->nws; ++i) {
-		output->workspaces[i] = full_screen_workspace(output);
-		if(!output->workspaces[i]) {
-			wlr_log(WLR_ERROR, "Failed to allocate workspaces for output");
-			return;
-		}
-		wl_list_init(&output->workspaces[i]->views);
-		wl_list_init(&output->workspaces[i]->unmanaged_views);
+	output->workspaces = calloc(server->nws, sizeof(struct cg_workspace *));
+	if(!output->workspaces ||
+	   output_get_workspace(output, output->curr_workspace) == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate workspaces for output");
+		return;
 	}
 
 	/* We are the first output. Set the current output to this one. */
 	if(server->curr_output == NULL) {
 		server->curr_output = output;
+		snapshot_schedule(server);
 	}
 	wlr_xcursor_manager_set_cursor_image(server->seat->xcursor_manager,
 	                                     DEFAULT_XCURSOR, server->seat->cursor);
@@ -685,6 +747,31 @@ handle_new_output(struct wl_listener *listener, void *data) {
 #pragma GCC diagnostic pop
 #endif
 
+/* Returns workspace ws of output, allocating it on first use. Returns NULL if
+ * the allocation fails. */
+struct cg_workspace *
+output_get_workspace(struct cg_output *output, uint32_t ws) {
+	if(output->workspaces[ws] == NULL) {
+		output->workspaces[ws] = full_screen_workspace(output);
+		if(output->workspaces[ws] == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate workspace %u", ws + 1);
+		}
+	}
+	return output->workspaces[ws];
+}
+
+/* Frees workspace ws of output if it is empty and not the current one */
+void
+output_reclaim_workspace(struct cg_output *output, uint32_t ws) {
+	struct cg_workspace *workspace = output->workspaces[ws];
+	if(workspace == NULL || (int)ws == output->curr_workspace ||
+	   !workspace_is_empty(workspace)) {
+		return;
+	}
+	workspace_free(workspace);
+	output->workspaces[ws] = NULL;
+}
+
 void
 output_set_window_title(struct cg_output *output, const char *title) {
 	struct wlr_output *wlr_output = output->wlr_output;
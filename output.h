@@ -1,6 +1,7 @@
 #ifndef CG_OUTPUT_H
 #define CG_OUTPUT_H
 
+#include <stdint.h>
 #include <wayland-server-core.h>
 #include <wlr/util/box.h>
 
@@ -9,6 +10,7 @@ struct cg_view;
 struct wlr_output;
 struct wlr_output_damage;
 struct wlr_surface;
+struct wlr_texture;
 
 struct cg_output {
 	struct cg_server *server;
@@ -17,11 +19,18 @@ struct cg_output {
 
 	struct wl_listener mode;
 	struct wl_listener commit;
+	struct wl_listener present;
 	struct wl_listener destroy;
 	struct wl_listener damage_frame;
 	struct wl_listener damage_destroy;
+	/* Workspaces are allocated on first use, unused ones are NULL */
 	struct cg_workspace **workspaces;
 	struct wl_list messages;
+	struct wl_list pending_messages; // cg_message_request::link
+	struct wl_list raster_jobs;      // Messages queued for the worker thread
+	/* All messages composited at their position, covering overlay_box */
+	struct wlr_texture *overlay;
+	struct wlr_box overlay_box;
 	int curr_workspace;
 	int priority;
 	struct cg_view *last_scanned_out_view;
@@ -73,6 +82,14 @@ void
 output_damage_surface(struct cg_output *output, struct wlr_surface *surface,
                       double ox, double oy, bool whole);
 void
+output_damage_single_surface(struct cg_output *output,
+                             struct wlr_surface *surface, double ox, double oy,
+                             bool whole);
+void
 output_set_window_title(struct cg_output *output, const char *title);
+struct cg_workspace *
+output_get_workspace(struct cg_output *output, uint32_t ws);
+void
+output_reclaim_workspace(struct cg_output *output, uint32_t ws);
 
 #endif
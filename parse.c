@@ -78,7 +78,10 @@ parse_command(struct cg_server *server, struct keybinding *keybinding,
               char *saveptr, char **errstr);
 
 /* Parse a keybinding definition and return it if successful, else return NULL
- */
+ *
+ * A key sequence such as "C-x,C-f" is returned as a chain of
+ * KEYBINDING_SEQUENCE_PREFIX keybindings, each holding the binding for the
+ * next key, which keybinding_list_push merges into the trie of the mode. */
 struct keybinding *
 parse_keybinding(struct cg_server *server, char **saveptr, char **errstr) {
 	struct keybinding *keybinding = malloc(sizeof(struct keybinding));
@@ -87,14 +90,43 @@ parse_keybinding(struct cg_server *server, char **saveptr, char **errstr) {
 		    "Failed to allocate memory for keybinding in parse_keybinding");
 		return NULL;
 	}
+	keybinding->action = KEYBINDING_NOOP;
 	char *key = strtok_r(NULL, " ", saveptr);
-	if(parse_key(keybinding, key, errstr) != 0) {
+	char *key_saveptr = NULL;
+	char *step = key == NULL ? NULL : strtok_r(key, ",", &key_saveptr);
+	if(parse_key(keybinding, step, errstr) != 0) {
 		wlr_log(WLR_ERROR, "Could not parse key definition \"%s\"", key);
 		free(keybinding);
 		return NULL;
 	}
-	if(parse_command(server, keybinding, *saveptr, errstr) != 0) {
-		free(keybinding);
+	struct keybinding *leaf = keybinding;
+	while((step = strtok_r(NULL, ",", &key_saveptr)) != NULL) {
+		struct keybinding *next = malloc(sizeof(struct keybinding));
+		struct keybinding_list *children = keybinding_list_init();
+		if(next == NULL || children == NULL) {
+			*errstr = log_error("Failed to allocate memory for key sequence "
+			                    "in parse_keybinding");
+			free(next);
+			keybinding_list_free(children);
+			keybinding_free(keybinding, true);
+			return NULL;
+		}
+		next->action = KEYBINDING_NOOP;
+		if(parse_key(next, step, errstr) != 0) {
+			wlr_log(WLR_ERROR, "Could not parse key definition \"%s\"", step);
+			free(next);
+			keybinding_list_free(children);
+			keybinding_free(keybinding, true);
+			return NULL;
+		}
+		keybinding_list_push(children, next);
+		leaf->action = KEYBINDING_SEQUENCE_PREFIX;
+		leaf->data.kl = children;
+		leaf = next;
+	}
+	if(parse_command(server, leaf, *saveptr, errstr) != 0) {
+		leaf->action = KEYBINDING_NOOP;
+		keybinding_free(keybinding, true);
 		return NULL;
 	}
 	return keybinding;
@@ -383,7 +415,7 @@ parse_definekey(struct cg_server *server, char **saveptr, char **errstr) {
 		    log_error("Too few arguments to \"definekey\". Expected mode");
 		return NULL;
 	}
-	int mode_idx = get_mode_index_from_name(server->modes, mode);
+	int mode_idx = get_mode_index_from_name(server, mode);
 	if(mode_idx == -1) {
 		*errstr = log_error("Unknown mode \"%s\"", mode);
 		return NULL;
@@ -641,6 +673,7 @@ parse_message_config(char **saveptr, char **errstr) {
 	cfg->bg_color[0] = -1;
 	cfg->fg_color[0] = -1;
 	cfg->display_time = -1;
+	cfg->coalesce = -1;
 	cfg->font = NULL;
 
 	char *setting = strtok_r(NULL, " ", saveptr);
@@ -665,6 +698,17 @@ parse_message_config(char **saveptr, char **errstr) {
 			              "display_time\", expected a non-negative integer");
 			goto error;
 		}
+	} else if(strcmp(setting, "coalesce") == 0) {
+		char *policy = strtok_r(NULL, " ", saveptr);
+		if(policy != NULL && strcmp(policy, "drop") == 0) {
+			cfg->coalesce = CG_MESSAGE_COALESCE_DROP;
+		} else if(policy != NULL && strcmp(policy, "merge") == 0) {
+			cfg->coalesce = CG_MESSAGE_COALESCE_MERGE;
+		} else {
+			*errstr = log_error("Error parsing command \"configure_message "
+			                    "coalesce\", expected \"drop\" or \"merge\"");
+			goto error;
+		}
 	} else if(strcmp(setting, "bg_color") == 0) {
 		for(int i = 0; i < 4; ++i) {
 			cfg->bg_color[i] = parse_float(saveptr, " ");
@@ -697,6 +741,16 @@ error:
 	return NULL;
 }
 
+/* Returns a copy of the rest of the line, which names the file a dump command
+ * writes to, or NULL if it is empty and the dump is sent over IPC */
+char *
+parse_optional_path(char *saveptr) {
+	if(saveptr == NULL || *saveptr == '\0') {
+		return NULL;
+	}
+	return strdup(saveptr);
+}
+
 int
 parse_command(struct cg_server *server, struct keybinding *keybinding,
               char *saveptr, char **errstr) {
@@ -757,6 +811,26 @@ parse_command(struct cg_server *server, struct keybinding *keybinding,
 			return -1;
 		}
 		keybinding->data.c = strdup(saveptr);
+	} else if(strcmp(action, "dumplayout") == 0) {
+		keybinding->action = KEYBINDING_DUMP_LAYOUT;
+		keybinding->data.c = parse_optional_path(saveptr);
+	} else if(strcmp(action, "dumplatency") == 0) {
+		keybinding->action = KEYBINDING_DUMP_LATENCY;
+		keybinding->data.c = parse_optional_path(saveptr);
+	} else if(strcmp(action, "dumpwatchdog") == 0) {
+		keybinding->action = KEYBINDING_DUMP_WATCHDOG;
+		keybinding->data.c = parse_optional_path(saveptr);
+	} else if(strcmp(action, "dumptrace") == 0) {
+		keybinding->action = KEYBINDING_DUMP_TRACE;
+		keybinding->data.c = parse_optional_path(saveptr);
+	} else if(strcmp(action, "restorelayout") == 0) {
+		keybinding->action = KEYBINDING_RESTORE_LAYOUT;
+		if(saveptr == NULL) {
+			*errstr = log_error("Not enough parameters to \"restorelayout\". "
+			                    "Expected file to read from.");
+			return -1;
+		}
+		keybinding->data.c = strdup(saveptr);
 	} else if(strcmp(action, "resizeleft") == 0) {
 		keybinding->action = KEYBINDING_RESIZE_TILE_HORIZONTAL;
 		keybinding->data.i = -10;
@@ -876,7 +950,7 @@ parse_command(struct cg_server *server, struct keybinding *keybinding,
 			*errstr = log_error("Expected mode after \"mode\". Got nothing.");
 			return -1;
 		}
-		int mode_idx = get_mode_index_from_name(server->modes, mode);
+		int mode_idx = get_mode_index_from_name(server, mode);
 		if(mode_idx == -1) {
 			*errstr = log_error("Unknown mode \"%s\" for \"mode\"", mode);
 			return -1;
@@ -890,7 +964,7 @@ parse_command(struct cg_server *server, struct keybinding *keybinding,
 			    "Expected mode after \"switch_default_mode\". Got nothing.");
 			return -1;
 		}
-		int mode_idx = get_mode_index_from_name(server->modes, mode);
+		int mode_idx = get_mode_index_from_name(server, mode);
 		if(mode_idx == -1) {
 			*errstr =
 			    log_error("Unknown mode \"%s\" for switch_default_mode", mode);
@@ -945,6 +1019,59 @@ parse_command(struct cg_server *server, struct keybinding *keybinding,
 		if(keybinding->data.i_cfg == NULL) {
 			return -1;
 		}
+	} else if(strcmp(action, "sequencetimeout") == 0) {
+		keybinding->action = KEYBINDING_SEQUENCE_TIMEOUT;
+		char *timeout_str = strtok_r(NULL, " ", &saveptr);
+		if(timeout_str == NULL) {
+			*errstr = log_error(
+			    "Expected argument for \"sequencetimeout\" command, got none.");
+			return -1;
+		}
+		char *endptr = NULL;
+		long timeout = strtol(timeout_str, &endptr, 10);
+		if(endptr == timeout_str || timeout < 0 || timeout > INT_MAX) {
+			*errstr = log_error("Expected a non-negative number of milliseconds "
+			                    "for \"sequencetimeout\", got \"%s\".",
+			                    timeout_str);
+			return -1;
+		}
+		keybinding->data.u = (uint32_t)timeout;
+	} else if(strcmp(action, "xwaylandidle") == 0) {
+		keybinding->action = KEYBINDING_XWAYLAND_IDLE;
+		char *timeout_str = strtok_r(NULL, " ", &saveptr);
+		if(timeout_str == NULL) {
+			*errstr = log_error(
+			    "Expected argument for \"xwaylandidle\" command, got none.");
+			return -1;
+		}
+		char *endptr = NULL;
+		long timeout = strtol(timeout_str, &endptr, 10);
+		if(endptr == timeout_str || timeout < 0 || timeout > INT_MAX / 1000) {
+			*errstr = log_error("Expected a non-negative number of seconds for "
+			                    "\"xwaylandidle\", got \"%s\".",
+			                    timeout_str);
+			return -1;
+		}
+		keybinding->data.u = (uint32_t)timeout;
+	} else if(strcmp(action, "snapshot") == 0) {
+		keybinding->action = KEYBINDING_SNAPSHOT;
+	} else if(strcmp(action, "watchdog") == 0) {
+		keybinding->action = KEYBINDING_WATCHDOG;
+		char *budget_str = strtok_r(NULL, " ", &saveptr);
+		if(budget_str == NULL) {
+			*errstr = log_error(
+			    "Expected argument for \"watchdog\" command, got none.");
+			return -1;
+		}
+		char *endptr = NULL;
+		long budget = strtol(budget_str, &endptr, 10);
+		if(endptr == budget_str || budget < 0 || budget > INT_MAX) {
+			*errstr = log_error("Expected a non-negative number of "
+			                    "milliseconds for \"watchdog\", got \"%s\".",
+			                    budget_str);
+			return -1;
+		}
+		keybinding->data.u = (uint32_t)budget;
 	} else if(strcmp(action, "configure_message") == 0) {
 		keybinding->action = KEYBINDING_CONFIGURE_MESSAGE;
 		keybinding->data.m_cfg = parse_message_config(&saveptr, errstr);
@@ -958,8 +1085,8 @@ parse_command(struct cg_server *server, struct keybinding *keybinding,
 	return 0;
 }
 
-int
-parse_rc_line(struct cg_server *server, char *line, char **errstr) {
+static int
+parse_line(struct cg_server *server, char *line, bool strict, char **errstr) {
 	char *saveptr = strdup(line); // Used internally by strtok_r
 
 	struct keybinding *keybinding = malloc(sizeof(struct keybinding));
@@ -976,8 +1103,23 @@ parse_rc_line(struct cg_server *server, char *line, char **errstr) {
 		free(saveptr);
 		return -1;
 	}
-	run_action(keybinding->action, server, keybinding->data);
+	int ret = run_action(keybinding->action, server, keybinding->data);
 	keybinding_free(keybinding, false);
 	free(saveptr);
+	if(strict && ret != 0) {
+		*errstr = log_error("Failed to run \"%s\".", line);
+		return -1;
+	}
 	return 0;
 }
+
+int
+parse_rc_line(struct cg_server *server, char *line, char **errstr) {
+	return parse_line(server, line, false, errstr);
+}
+
+/* Like parse_rc_line, but also fails if the command itself failed */
+int
+parse_command_line(struct cg_server *server, char *line, char **errstr) {
+	return parse_line(server, line, true, errstr);
+}
@@ -10,6 +10,8 @@ struct cg_server;
 
 int
 parse_rc_line(struct cg_server *server, char *line, char **errstr);
+int
+parse_command_line(struct cg_server *server, char *line, char **errstr);
 char *
 parse_malloc_vsprintf(const char *fmt, ...);
 char *
@@ -0,0 +1,118 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+
+#include "pool.h"
+
+struct cg_pool_slab {
+	struct cg_pool_slab *next;
+	max_align_t objects[];
+};
+
+void
+pool_init(struct cg_pool *pool, const char *name, size_t object_size,
+          size_t objects_per_slab) {
+	/* Free objects hold the free list link and every object has to be
+	 * suitably aligned for any type */
+	if(object_size < sizeof(void *)) {
+		object_size = sizeof(void *);
+	}
+	size_t align = alignof(max_align_t);
+	pool->name = name;
+	pool->object_size = (object_size + align - 1) / align * align;
+	pool->objects_per_slab = objects_per_slab > 0 ? objects_per_slab : 1;
+	pool->free_list = NULL;
+	pool->slabs = NULL;
+#if CG_HAS_POOL_STATS
+	memset(&pool->stats, 0, sizeof(pool->stats));
+#endif
+}
+
+static int
+pool_grow(struct cg_pool *pool) {
+	struct cg_pool_slab *slab =
+	    malloc(sizeof(struct cg_pool_slab) +
+	           pool->objects_per_slab * pool->object_size);
+	if(slab == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate slab for pool \"%s\"",
+		        pool->name);
+		return -1;
+	}
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+
+	/* Thread the objects onto the free list back to front, so that they are
+	 * handed out in address order */
+	unsigned char *objects = (unsigned char *)slab->objects;
+	for(size_t i = pool->objects_per_slab; i > 0; --i) {
+		void *object = objects + (i - 1) * pool->object_size;
+		*(void **)object = pool->free_list;
+		pool->free_list = object;
+	}
+#if CG_HAS_POOL_STATS
+	++pool->stats.slabs;
+#endif
+	return 0;
+}
+
+/* Returns a zeroed object or NULL if no memory is available */
+void *
+pool_alloc(struct cg_pool *pool) {
+	if(pool->free_list == NULL && pool_grow(pool) != 0) {
+		return NULL;
+	}
+	void *object = pool->free_list;
+	pool->free_list = *(void **)object;
+	memset(object, 0, pool->object_size);
+#if CG_HAS_POOL_STATS
+	++pool->stats.allocs;
+	if(++pool->stats.in_use > pool->stats.peak) {
+		pool->stats.peak = pool->stats.in_use;
+	}
+#endif
+	return object;
+}
+
+void
+pool_free(struct cg_pool *pool, void *object) {
+	if(object == NULL) {
+		return;
+	}
+	*(void **)object = pool->free_list;
+	pool->free_list = object;
+#if CG_HAS_POOL_STATS
+	++pool->stats.frees;
+	--pool->stats.in_use;
+#endif
+}
+
+/* Frees all slabs of pool. Objects still in use become invalid. */
+void
+pool_fini(struct cg_pool *pool) {
+#if CG_HAS_POOL_STATS
+	wlr_log(WLR_INFO,
+	        "Pool \"%s\": %zu allocations, %zu frees, %zu in use, peak %zu, "
+	        "%zu slabs of %zu bytes",
+	        pool->name, pool->stats.allocs, pool->stats.frees,
+	        pool->stats.in_use, pool->stats.peak, pool->stats.slabs,
+	        pool->objects_per_slab * pool->object_size);
+#endif
+	while(pool->slabs != NULL) {
+		struct cg_pool_slab *next = pool->slabs->next;
+		free(pool->slabs);
+		pool->slabs = next;
+	}
+	pool->free_list = NULL;
+}
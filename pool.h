@@ -0,0 +1,44 @@
+#ifndef CG_POOL_H
+#define CG_POOL_H
+
+#include "config.h"
+
+#include <stddef.h>
+
+struct cg_pool_slab;
+
+/* Allocator for small objects of a single type. Objects are carved out of
+ * slabs, which are only returned to the system by pool_fini. Freed objects
+ * are kept on a free list for reuse. Pools are not thread-safe. */
+struct cg_pool {
+	const char *name;
+	size_t object_size;
+	size_t objects_per_slab;
+	void *free_list;
+	struct cg_pool_slab *slabs;
+#if CG_HAS_POOL_STATS
+	struct {
+		size_t allocs;
+		size_t frees;
+		size_t in_use;
+		size_t peak;
+		size_t slabs;
+	} stats;
+#endif
+};
+
+/* Initializes pool for objects of the given type */
+#define POOL_INIT(pool, type, objects_per_slab)                                \
+	pool_init((pool), #type, sizeof(type), (objects_per_slab))
+
+void
+pool_init(struct cg_pool *pool, const char *name, size_t object_size,
+          size_t objects_per_slab);
+void *
+pool_alloc(struct cg_pool *pool);
+void
+pool_free(struct cg_pool *pool, void *object);
+void
+pool_fini(struct cg_pool *pool);
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <wlr/util/log.h>
+
+#include "process.h"
+
+extern char **environ;
+
+/* Processes started by process_spawn which were not reaped yet. Only these
+ * are waited for, other children such as the one wlroots forks to start
+ * Xwayland are reaped by their owners. */
+static pid_t *children = NULL;
+static size_t children_len = 0;
+static size_t children_size = 0;
+
+/* Commands containing any of these characters are run through /bin/sh, all
+ * others are split at blanks and executed directly */
+static const char shell_chars[] = "|&;<>()$`\\\"'*?[]#~=\n";
+static const char blank_chars[] = " \t";
+
+/* Splits command into a NULL-terminated argument vector. The strings point
+ * into *buffer, both have to be freed by the caller. */
+static char **
+split_command(const char *command, char **buffer) {
+	*buffer = strdup(command);
+	if(*buffer == NULL) {
+		return NULL;
+	}
+	size_t argc = 0;
+	for(const char *c = command; *c != '\0';) {
+		c += strspn(c, blank_chars);
+		if(*c != '\0') {
+			++argc;
+			c += strcspn(c, blank_chars);
+		}
+	}
+	char **argv = calloc(argc + 1, sizeof(char *));
+	if(argv == NULL) {
+		free(*buffer);
+		*buffer = NULL;
+		return NULL;
+	}
+	char *saveptr = NULL;
+	size_t i = 0;
+	for(char *arg = strtok_r(*buffer, blank_chars, &saveptr); arg != NULL;
+	    arg = strtok_r(NULL, blank_chars, &saveptr)) {
+		argv[i++] = arg;
+	}
+	return argv;
+}
+
+static bool
+process_track(pid_t pid) {
+	if(children_len == children_size) {
+		size_t size = children_size == 0 ? 8 : children_size * 2;
+		pid_t *new_children = realloc(children, size * sizeof(pid_t));
+		if(new_children == NULL) {
+			return false;
+		}
+		children = new_children;
+		children_size = size;
+	}
+	children[children_len++] = pid;
+	return true;
+}
+
+/* Runs command without waiting for it. posix_spawn does not copy the page
+ * tables of the compositor like fork does. The child is reaped by
+ * process_reap_children once it exits. */
+int
+process_spawn(const char *command) {
+	char *sh_argv[] = {"sh", "-c", (char *)command, NULL};
+	char **argv = sh_argv;
+	char *buffer = NULL;
+	bool use_shell = strpbrk(command, shell_chars) != NULL;
+	if(!use_shell) {
+		argv = split_command(command, &buffer);
+		if(argv == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate arguments of \"%s\"",
+			        command);
+			return -1;
+		}
+		if(argv[0] == NULL) {
+			free(argv);
+			free(buffer);
+			return 0;
+		}
+	}
+
+	/* The event loop blocks the signals it handles, the child should start
+	 * out with a clean signal state */
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	sigset_t mask;
+	sigemptyset(&mask);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &mask);
+	posix_spawnattr_setflags(&attr,
+	                         POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+	pid_t pid;
+	int err;
+	if(use_shell) {
+		err = posix_spawn(&pid, "/bin/sh", NULL, &attr, argv, environ);
+	} else {
+		err = posix_spawnp(&pid, argv[0], NULL, &attr, argv, environ);
+	}
+	posix_spawnattr_destroy(&attr);
+
+	if(!use_shell) {
+		free(argv);
+		free(buffer);
+	}
+	if(err != 0) {
+		wlr_log(WLR_ERROR, "Failed to run \"%s\": %s", command, strerror(err));
+		return -1;
+	}
+	if(!process_track(pid)) {
+		wlr_log(WLR_ERROR, "Unable to track process %d, it will not be reaped",
+		        (int)pid);
+	}
+	wlr_log(WLR_DEBUG, "Started \"%s\" as process %d", command, (int)pid);
+	return 0;
+}
+
+/* Collects the exit status of the spawned processes which have terminated,
+ * called on SIGCHLD */
+void
+process_reap_children(void) {
+	size_t i = 0;
+	while(i < children_len) {
+		int status;
+		pid_t pid = waitpid(children[i], &status, WNOHANG);
+		if(pid == 0 || (pid == -1 && errno == EINTR)) {
+			++i;
+			continue;
+		}
+		if(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+			wlr_log(WLR_DEBUG, "Process %d exited with status %d", (int)pid,
+			        WEXITSTATUS(status));
+		}
+		children[i] = children[--children_len];
+	}
+}
@@ -0,0 +1,9 @@
+#ifndef CG_PROCESS_H
+#define CG_PROCESS_H
+
+int
+process_spawn(const char *command);
+void
+process_reap_children(void);
+
+#endif
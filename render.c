@@ -20,10 +20,12 @@
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 
+#include "latency.h"
 #include "message.h"
 #include "output.h"
 #include "seat.h"
 #include "server.h"
+#include "trace.h"
 #include "util.h"
 #include "view.h"
 #include "workspace.h"
@@ -53,10 +55,13 @@ struct render_data {
 	int tile_width, tile_height;
 };
 
+/* Draws texture, or only the part of it in src_box if that is not NULL, at
+ * box on the output */
 static void
 render_texture(struct wlr_output *wlr_output, pixman_region32_t *output_damage,
-               struct wlr_texture *texture, const struct wlr_box *box,
-               const float matrix[static 9], struct wlr_renderer *renderer) {
+               struct wlr_texture *texture, const struct wlr_fbox *src_box,
+               const struct wlr_box *box, const float matrix[static 9],
+               struct wlr_renderer *renderer) {
 	pixman_region32_t damage;
 	pixman_region32_init(&damage);
 	pixman_region32_union_rect(&damage, &damage, box->x, box->y, box->width,
@@ -70,7 +75,12 @@ render_texture(struct wlr_output *wlr_output, pixman_region32_t *output_damage,
 	pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
 	for(int i = 0; i < nrects; i++) {
 		scissor_output(wlr_output, &rects[i], renderer);
-		wlr_render_texture_with_matrix(renderer, texture, matrix, 1.0F);
+		if(src_box != NULL) {
+			wlr_render_subtexture_with_matrix(renderer, texture, src_box,
+			                                  matrix, 1.0F);
+		} else {
+			wlr_render_texture_with_matrix(renderer, texture, matrix, 1.0F);
+		}
 	}
 
 damage_finish:
@@ -106,10 +116,41 @@ render_surface_iterator(struct cg_output *output, struct wlr_surface *surface,
 		box->height =
 		    box->height > data->tile_height ? data->tile_height : box->height;
 	}
-	render_texture(wlr_output, output_damage, texture, box, matrix,
+	render_texture(wlr_output, output_damage, texture, NULL, box, matrix,
 	               output->server->renderer);
 }
 
+/* Draws the overlay holding all messages of the output at once, restricted to
+ * the damaged parts of the message boxes */
+static void
+render_messages(struct cg_output *output, pixman_region32_t *output_damage,
+                struct wlr_renderer *renderer) {
+	struct wlr_texture *overlay = message_overlay_texture(output);
+	if(overlay == NULL) {
+		return;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	struct cg_message *message;
+	wl_list_for_each(message, &output->messages, link) {
+		pixman_region32_union_rect(
+		    &damage, &damage, message->position.x, message->position.y,
+		    message->position.width, message->position.height);
+	}
+	pixman_region32_intersect(&damage, &damage, output_damage);
+
+	struct wlr_box *box = &output->overlay_box;
+	struct wlr_fbox src_box = {
+	    .x = 0, .y = 0, .width = box->width, .height = box->height};
+	float matrix[9];
+	wlr_matrix_project_box(matrix, box, WL_OUTPUT_TRANSFORM_NORMAL, 0.0F,
+	                       output->wlr_output->transform_matrix);
+	render_texture(output->wlr_output, &damage, overlay, &src_box, box, matrix,
+	               renderer);
+	pixman_region32_fini(&damage);
+}
+
 static void
 render_drag_icons(struct cg_output *output, pixman_region32_t *damage,
                   struct wl_list *drag_icons) {
@@ -122,6 +163,22 @@ render_drag_icons(struct cg_output *output, pixman_region32_t *damage,
 	                                   render_surface_iterator, &data);
 }
 
+/* Returns whether the box in output coordinates overlaps the damage */
+static bool
+damage_intersects_box(struct wlr_output *wlr_output, pixman_region32_t *damage,
+                      const struct wlr_box *box) {
+	struct wlr_box scaled = *box;
+	scale_box(&scaled, wlr_output->scale);
+	pixman_box32_t rect = {
+	    .x1 = scaled.x,
+	    .y1 = scaled.y,
+	    .x2 = scaled.x + scaled.width,
+	    .y2 = scaled.y + scaled.height,
+	};
+	return pixman_region32_contains_rectangle(damage, &rect) !=
+	       PIXMAN_REGION_OUT;
+}
+
 /**
  * Render all toplevels without descending into popups.
  */
@@ -183,6 +240,8 @@ output_render(struct cg_output *output, pixman_region32_t *damage) {
 		return;
 	}
 
+	TRACE_BEGIN(trace_start);
+	latency_render(server);
 	wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
 
 	if(!pixman_region32_not_empty(damage)) {
@@ -216,11 +275,16 @@ output_render(struct cg_output *output, pixman_region32_t *damage) {
 		}
 	}
 
-	struct cg_view *view;
-	wl_list_for_each_reverse(
-	    view, &output->workspaces[output->curr_workspace]->unmanaged_views,
-	    link) {
-		render_view_toplevels(view, output, damage);
+	struct cg_workspace *ws = output->workspaces[output->curr_workspace];
+	if(damage_intersects_box(wlr_output, damage, &ws->unmanaged_box)) {
+		struct cg_view *view;
+		wl_list_for_each_reverse(view, &ws->unmanaged_views, link) {
+			struct wlr_box box;
+			view_get_box(view, &box);
+			if(damage_intersects_box(wlr_output, damage, &box)) {
+				render_view_toplevels(view, output, damage);
+			}
+		}
 	}
 
 	struct cg_view *focused_view = seat_get_focus(server->seat);
@@ -228,15 +292,7 @@ output_render(struct cg_output *output, pixman_region32_t *damage) {
 		render_view_popups(focused_view, output, damage);
 	}
 
-	struct cg_message *message;
-	wl_list_for_each_reverse(message, &output->messages, link) {
-		float matrix[9];
-		wlr_matrix_project_box(matrix, message->position,
-		                       WL_OUTPUT_TRANSFORM_NORMAL, 0.0F,
-		                       wlr_output->transform_matrix);
-		render_texture(output->wlr_output, damage, message->message,
-		               message->position, matrix, renderer);
-	}
+	render_messages(output, damage, renderer);
 	render_drag_icons(output, damage, &server->seat->drag_icons);
 
 renderer_end:
@@ -271,4 +327,5 @@ renderer_end:
 	if(!wlr_output_commit(wlr_output)) {
 		wlr_log(WLR_ERROR, "Could not commit output");
 	}
+	TRACE_END(trace_start, "output.render");
 }
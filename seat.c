@@ -33,11 +33,15 @@
 
 #include "input_manager.h"
 #include "keybinding.h"
+#include "latency.h"
 #include "message.h"
 #include "output.h"
 #include "seat.h"
 #include "server.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "view.h"
+#include "watchdog.h"
 #include "workspace.h"
 #if CG_HAS_XWAYLAND
 #include "xwayland.h"
@@ -82,14 +86,21 @@ view_at(const struct cg_view *view, double lx, double ly,
 static struct cg_view *
 desktop_view_at(const struct cg_server *server, double lx, double ly,
                 struct wlr_surface **surface, double *sx, double *sy) {
-	struct cg_view *view;
-	wl_list_for_each(
-	    view,
-	    &server->curr_output->workspaces[server->curr_output->curr_workspace]
-	         ->unmanaged_views,
-	    link) {
-		if(view_at(view, lx, ly, surface, sx, sy)) {
-			return view;
+	struct cg_workspace *ws =
+	    server->curr_output->workspaces[server->curr_output->curr_workspace];
+	struct wlr_box *output_box = wlr_output_layout_get_box(
+	    server->output_layout, server->curr_output->wlr_output);
+	double ox = output_box != NULL ? lx - output_box->x : lx;
+	double oy = output_box != NULL ? ly - output_box->y : ly;
+	if(wlr_box_contains_point(&ws->unmanaged_box, ox, oy)) {
+		struct cg_view *view;
+		wl_list_for_each(view, &ws->unmanaged_views, link) {
+			struct wlr_box box;
+			view_get_box(view, &box);
+			if(wlr_box_contains_point(&box, ox, oy) &&
+			   view_at(view, lx, ly, surface, sx, sy)) {
+				return view;
+			}
 		}
 	}
 
@@ -252,17 +263,49 @@ keyboard_disarm_key_repeat(struct cg_keyboard_group *group) {
 	}
 }
 
+static int
+handle_sequence_timeout(void *data) {
+	struct cg_seat *seat = data;
+	if(seat->pending_sequence != NULL) {
+		wlr_log(WLR_DEBUG, "Key sequence timed out");
+		seat->pending_sequence = NULL;
+	}
+	return 0;
+}
+
 static bool
 handle_command_key_bindings(struct cg_server *server, xkb_keysym_t sym,
                             uint32_t modifiers, uint32_t mode,
                             struct cg_keyboard_group *group) {
+	struct cg_seat *seat = server->seat;
+	bool in_sequence = seat->pending_sequence != NULL;
+	const struct keybinding_list *list = in_sequence
+	                                         ? seat->pending_sequence
+	                                         : server->modes[mode].keybindings;
+	if(in_sequence) {
+		seat->pending_sequence = NULL;
+		if(wl_event_source_timer_update(seat->sequence_timer, 0) < 0) {
+			wlr_log(WLR_DEBUG, "failed to disarm key sequence timer");
+		}
+	}
 	struct keybinding **keybinding = find_keybinding(
-	    server->keybindings,
+	    list,
 	    &(struct keybinding){.key = sym, .mode = mode, .modifiers = modifiers});
 	server->seat->mode =
 	    server->seat
 	        ->default_mode; // Return to mode we are currently in by default
-	if(keybinding) {
+	snapshot_schedule(server);
+	if(keybinding && (*keybinding)->action == KEYBINDING_SEQUENCE_PREFIX) {
+		/* Descend one level into the trie and wait for the next key */
+		seat->pending_sequence = (*keybinding)->data.kl;
+		if(server->sequence_timeout > 0 &&
+		   wl_event_source_timer_update(seat->sequence_timer,
+		                                server->sequence_timeout) < 0) {
+			wlr_log(WLR_DEBUG, "failed to set key sequence timer");
+		}
+		wlr_idle_notify_activity(server->idle, server->seat->seat);
+		return true;
+	} else if(keybinding) {
 		wlr_log(
 		    WLR_DEBUG,
 		    "Recognized keybinding pressed (key: %d, mode: %d, modifiers: %d)",
@@ -278,9 +321,22 @@ handle_command_key_bindings(struct cg_server *server, xkb_keysym_t sym,
 			}
 		}
 		message_clear(group->seat->server->curr_output);
+		char keysym_name[64];
+		xkb_keysym_get_name(sym, keysym_name, sizeof(keysym_name));
+		watchdog_context(server,
+		                 "key binding %s in mode %s (modifiers 0x%x, "
+		                 "command %s)",
+		                 keysym_name, server->modes[mode].name, modifiers,
+		                 keybinding_command_name(*keybinding));
 		run_action((*keybinding)->action, server, (*keybinding)->data);
 		wlr_idle_notify_activity(server->idle, server->seat->seat);
 		return true;
+	} else if(in_sequence) {
+		/* An unbound key aborts the sequence and is swallowed */
+		wlr_log(WLR_DEBUG,
+		        "Key sequence aborted (key: %d, mode: %d, modifiers: %d)", sym,
+		        mode, modifiers);
+		return true;
 	} else if(mode != 0) {
 		run_action(KEYBINDING_NOOP, server, (union keybinding_params){NULL});
 		message_printf(server->curr_output, "unbound key pressed");
@@ -327,6 +383,10 @@ handle_key_event(struct cg_keyboard_group *group, struct cg_seat *seat,
 
 	bool handled = false;
 
+	if(event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+		latency_input(seat->server, CG_LATENCY_KEY, event->time_msec);
+	}
+
 	for(int i = 0; i < nsyms; ++i) {
 		if(event->state == WL_KEYBOARD_KEY_STATE_PRESSED &&
 		   !key_is_modifier(syms[i])) {
@@ -361,7 +421,11 @@ static void
 handle_keyboard_group_key(struct wl_listener *listener, void *data) {
 	struct cg_keyboard_group *cg_group =
 	    wl_container_of(listener, cg_group, key);
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(cg_group->seat->server);
 	handle_key_event(cg_group, cg_group->seat, data);
+	watchdog_end(cg_group->seat->server, CG_WATCHDOG_KEY, watchdog_start);
+	TRACE_END(trace_start, "seat.key");
 }
 
 static void
@@ -664,13 +728,26 @@ handle_cursor_button(struct wl_listener *listener, void *data) {
 	struct cg_seat *seat = wl_container_of(listener, seat, cursor_button);
 	struct wlr_event_pointer_button *event = data;
 
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(seat->server);
+	if(event->state == WLR_BUTTON_PRESSED) {
+		latency_input(seat->server, CG_LATENCY_BUTTON, event->time_msec);
+	}
 	wlr_seat_pointer_notify_button(seat->seat, event->time_msec, event->button,
 	                               event->state);
 	wlr_idle_notify_activity(seat->server->idle, seat->seat);
+	watchdog_end(seat->server, CG_WATCHDOG_BUTTON, watchdog_start);
+	TRACE_END(trace_start, "seat.button");
 }
 
 static void
 process_cursor_motion(struct cg_seat *seat, uint32_t time) {
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(seat->server);
+	/* time is -1 if the cursor was only rebased, e.g. after a layout change */
+	if(time != (uint32_t)-1) {
+		latency_input(seat->server, CG_LATENCY_MOTION, time);
+	}
 	double sx, sy;
 	struct wlr_seat *wlr_seat = seat->seat;
 	struct wlr_surface *surface = NULL;
@@ -695,6 +772,8 @@ process_cursor_motion(struct cg_seat *seat, uint32_t time) {
 	}
 
 	wlr_idle_notify_activity(seat->server->idle, seat->seat);
+	watchdog_end(seat->server, CG_WATCHDOG_MOTION, watchdog_start);
+	TRACE_END(trace_start, "seat.motion");
 }
 
 static void
@@ -854,6 +933,9 @@ handle_destroy(struct wl_listener *listener, void *_data) {
 	wl_list_remove(&seat->request_set_cursor.link);
 	wl_list_remove(&seat->request_set_selection.link);
 	wl_list_remove(&seat->request_set_primary_selection.link);
+	if(seat->sequence_timer != NULL) {
+		wl_event_source_remove(seat->sequence_timer);
+	}
 	free(seat);
 }
 
@@ -940,6 +1022,10 @@ seat_create(struct cg_server *server, struct wlr_backend *backend) {
 	seat->mode = 0;
 	seat->default_mode = 0;
 
+	seat->pending_sequence = NULL;
+	seat->sequence_timer = wl_event_loop_add_timer(
+	    server->event_loop, handle_sequence_timeout, seat);
+
 	return seat;
 }
 
@@ -969,10 +1055,16 @@ seat_set_focus(struct cg_seat *seat, struct cg_view *view) {
 	struct wlr_seat *wlr_seat = seat->seat;
 	struct cg_view *prev_view = seat_get_focus(seat);
 
+	snapshot_schedule(server);
+
 	/* Focusing the background */
 	if(view == NULL) {
-		server->curr_output->workspaces[server->curr_output->curr_workspace]
-		    ->focused_tile->view = NULL;
+		struct cg_tile *tile =
+		    server->curr_output->workspaces[server->curr_output->curr_workspace]
+		        ->focused_tile;
+		struct cg_view *hidden_view = tile->view;
+		tile->view = NULL;
+		view_update_hidden(hidden_view);
 		seat->focused_view = NULL;
 		if(prev_view != NULL) {
 			view_activate(prev_view, false);
@@ -991,14 +1083,16 @@ seat_set_focus(struct cg_seat *seat, struct cg_view *view) {
 		        ->workspaces[server->curr_output->curr_workspace];
 		view_maximize(view, curr_workspace->focused_tile);
 		if(!view_is_visible(view)) {
+			struct cg_view *hidden_view = curr_workspace->focused_tile->view;
 			wl_list_remove(&view->link);
-			if(curr_workspace->focused_tile->view != NULL) {
-				wl_list_insert(&curr_workspace->focused_tile->view->link,
-				               &view->link);
+			if(hidden_view != NULL) {
+				wl_list_insert(&hidden_view->link, &view->link);
 			} else {
 				wl_list_insert(curr_workspace->views.prev, &view->link);
 			}
 			curr_workspace->focused_tile->view = view;
+			view_update_hidden(hidden_view);
+			view_update_hidden(view);
 		}
 	}
 
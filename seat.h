@@ -11,6 +11,7 @@ struct cg_input_device;
 struct wlr_seat;
 struct wlr_xcursor_manager;
 struct wlr_backend;
+struct keybinding_list;
 
 #define DEFAULT_XCURSOR "left_ptr"
 #define XCURSOR_SIZE 24
@@ -52,6 +53,11 @@ struct cg_seat {
 	uint16_t mode;
 	uint16_t default_mode;
 
+	/* Bindings for the next key of a partially entered key sequence, NULL if
+	 * no sequence is pending */
+	const struct keybinding_list *pending_sequence;
+	struct wl_event_source *sequence_timer;
+
 	struct wl_shm *shm; // Shared memory
 
 	struct cg_view *focused_view;
@@ -10,15 +10,21 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/box.h>
+#include <wlr/util/log.h>
 
 #include "input_manager.h"
+#include "keybinding.h"
 #include "output.h"
 #include "server.h"
 #include "util.h"
+#include "view.h"
+#include "workspace.h"
+#include "xdg_shell.h"
 
 void
 display_terminate(struct cg_server *server) {
@@ -29,18 +35,120 @@ display_terminate(struct cg_server *server) {
 	wl_display_terminate(server->wl_display);
 }
 
+static uint32_t
+mode_name_hash(const char *mode_name) {
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	for(const unsigned char *c = (const unsigned char *)mode_name; *c != '\0';
+	    ++c) {
+		hash ^= *c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 /* Returns the index of a mode given its name or "-1" if the mode is not found.
  */
 int
-get_mode_index_from_name(char *const *modes, const char *mode_name) {
-	for(int i = 0; modes[i] != NULL; ++i) {
-		if(strcmp(modes[i], mode_name) == 0) {
+get_mode_index_from_name(const struct cg_server *server,
+                         const char *mode_name) {
+	uint32_t hash = mode_name_hash(mode_name);
+	for(int i = 0; i < server->nmodes; ++i) {
+		if(server->modes[i].name_hash == hash &&
+		   strcmp(server->modes[i].name, mode_name) == 0) {
 			return i;
 		}
 	}
 	return -1;
 }
 
+/* Interns a mode name and returns its index, or "-1" on failure. Defining a
+ * mode which already exists returns the existing index. */
+int
+server_add_mode(struct cg_server *server, const char *mode_name) {
+	int idx = get_mode_index_from_name(server, mode_name);
+	if(idx != -1) {
+		return idx;
+	}
+	if(server->nmodes == UINT16_MAX) {
+		wlr_log(WLR_ERROR, "Too many modes defined");
+		return -1;
+	}
+	if(server->nmodes == server->modes_capacity) {
+		uint32_t capacity =
+		    server->modes_capacity == 0 ? 8 : 2 * server->modes_capacity;
+		if(capacity > UINT16_MAX) {
+			capacity = UINT16_MAX;
+		}
+		struct cg_mode *tmp =
+		    realloc(server->modes, capacity * sizeof(struct cg_mode));
+		if(tmp == NULL) {
+			wlr_log(WLR_ERROR, "Could not allocate memory for storing modes.");
+			return -1;
+		}
+		server->modes = tmp;
+		server->modes_capacity = capacity;
+	}
+	struct cg_mode *mode = &server->modes[server->nmodes];
+	mode->name = strdup(mode_name);
+	mode->name_hash = mode_name_hash(mode_name);
+	mode->keybindings = keybinding_list_init();
+	if(mode->name == NULL || mode->keybindings == NULL) {
+		wlr_log(WLR_ERROR, "Could not allocate memory for mode \"%s\".",
+		        mode_name);
+		free(mode->name);
+		keybinding_list_free(mode->keybindings);
+		return -1;
+	}
+	return server->nmodes++;
+}
+
+/* Defines the built-in modes "top", "root" and "resize" at indices 0, 1 and 2
+ */
+int
+server_modes_init(struct cg_server *server) {
+	server->modes = NULL;
+	server->nmodes = 0;
+	server->modes_capacity = 0;
+	if(server_add_mode(server, "top") != 0 ||
+	   server_add_mode(server, "root") != 1 ||
+	   server_add_mode(server, "resize") != 2) {
+		return -1;
+	}
+	return 0;
+}
+
+void
+server_modes_fini(struct cg_server *server) {
+	for(uint16_t i = 0; i < server->nmodes; ++i) {
+		free(server->modes[i].name);
+		keybinding_list_free(server->modes[i].keybindings);
+	}
+	free(server->modes);
+	server->modes = NULL;
+	server->nmodes = 0;
+	server->modes_capacity = 0;
+}
+
+void
+server_pools_init(struct cg_server *server) {
+	POOL_INIT(&server->tile_pool, struct cg_tile, 64);
+	POOL_INIT(&server->subsurface_pool, struct cg_subsurface, 64);
+	POOL_INIT(&server->popup_pool, struct cg_xdg_popup, 64);
+	POOL_INIT(&server->message_pool, struct cg_message, 32);
+	POOL_INIT(&server->message_request_pool, struct cg_message_request, 32);
+}
+
+/* Must only be called once all objects allocated from the pools are gone */
+void
+server_pools_fini(struct cg_server *server) {
+	pool_fini(&server->tile_pool);
+	pool_fini(&server->subsurface_pool);
+	pool_fini(&server->popup_pool);
+	pool_fini(&server->message_pool);
+	pool_fini(&server->message_request_pool);
+}
+
 char *
 server_show_info(struct cg_server *server) {
 	char *output_str = strdup(""), *output_str_tmp;
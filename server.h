@@ -3,6 +3,8 @@
 
 #include "config.h"
 #include "ipc_server.h"
+#include "message.h"
+#include "pool.h"
 
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_xdg_decoration_v1.h>
@@ -14,6 +16,21 @@ struct wlr_output_layout;
 struct wlr_idle_inhibit_manager_v1;
 struct cg_output_config;
 struct cg_input_manager;
+struct cg_message_worker;
+struct cg_latency;
+struct cg_watchdog;
+struct cg_snapshot_handle;
+struct wlr_compositor;
+struct wlr_xwayland;
+
+/* Modes are interned: once defined, a mode is referred to solely by its index
+ * into cg_server.modes, and every mode owns the table of keybindings that are
+ * active while it is selected. */
+struct cg_mode {
+	char *name;
+	uint32_t name_hash;
+	struct keybinding_list *keybindings;
+};
 
 struct cg_server {
 	struct wl_display *wl_display;
@@ -38,10 +55,15 @@ struct cg_server {
 	struct wl_listener xdg_toplevel_decoration;
 	struct wl_listener new_xdg_shell_surface;
 #if CG_HAS_XWAYLAND
+	struct wlr_compositor *compositor;
+	struct wlr_xwayland *xwayland;
 	struct wl_listener new_xwayland_surface;
+	struct wl_listener xwayland_ready;
+	struct wl_event_source *xwayland_idle; // Shuts down XWayland when unused
+	uint32_t xwayland_surfaces;            // Number of existing X windows
+	bool xwayland_running; // The X server has been started by a client
 #endif
 
-	struct keybinding_list *keybindings;
 	struct wl_list output_config;
 	struct wl_list input_config;
 
@@ -50,9 +72,26 @@ struct cg_server {
 	struct cg_ipc_handle ipc;
 
 	bool running;
-	char **modes;
+	struct cg_mode *modes;
+	uint16_t nmodes;
+	uint16_t modes_capacity;
+
+	/* Small objects which are created and destroyed frequently */
+	struct cg_pool tile_pool;
+	struct cg_pool subsurface_pool;
+	struct cg_pool popup_pool;
+	struct cg_pool message_pool;
+	struct cg_pool message_request_pool;
 	uint16_t nws;
 	uint16_t message_timeout;
+	enum cg_message_coalesce message_coalesce;
+	struct cg_message_worker *message_worker; // NULL to rasterize inline
+	uint32_t sequence_timeout; // in milliseconds, 0 waits indefinitely
+	uint32_t xwayland_idle_timeout; // in seconds, 0 keeps XWayland running
+	struct cg_latency *latency;     // Input-to-present latency statistics
+	struct cg_watchdog *watchdog;   // Dispatch time of event loop handlers
+	/* State shared with IPC clients, NULL until one asked for it */
+	struct cg_snapshot_handle *snapshot;
 	float *bg_color;
 #ifdef DEBUG
 	bool debug_damage_tracking;
@@ -62,7 +101,18 @@ struct cg_server {
 void
 display_terminate(struct cg_server *server);
 int
-get_mode_index_from_name(char *const *modes, const char *mode_name);
+get_mode_index_from_name(const struct cg_server *server,
+                         const char *mode_name);
+int
+server_add_mode(struct cg_server *server, const char *mode_name);
+int
+server_modes_init(struct cg_server *server);
+void
+server_modes_fini(struct cg_server *server);
+void
+server_pools_init(struct cg_server *server);
+void
+server_pools_fini(struct cg_server *server);
 char *
 server_show_info(struct cg_server *server);
 
@@ -0,0 +1,182 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _GNU_SOURCE // memfd_create and file seals
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+#include "ipc_server.h"
+#include "output.h"
+#include "seat.h"
+#include "server.h"
+#include "snapshot.h"
+#include "view.h"
+
+struct cg_snapshot_handle {
+	int fd;
+	struct cg_snapshot *shm;
+	struct wl_event_source *idle; // Pending update, NULL if there is none
+};
+
+static void
+copy_string(char *dst, size_t size, const char *src) {
+	snprintf(dst, size, "%s", src != NULL ? src : "");
+}
+
+static void
+snapshot_collect(struct cg_server *server, struct cg_snapshot_state *state) {
+	memset(state, 0, sizeof(*state));
+	struct cg_output *output = server->curr_output;
+	if(output != NULL) {
+		copy_string(state->output, sizeof(state->output),
+		            output->wlr_output->name);
+		state->workspace = output->curr_workspace + 1;
+	}
+	state->nws = server->nws;
+	if(server->seat != NULL) {
+		copy_string(state->mode, sizeof(state->mode),
+		            server->modes[server->seat->mode].name);
+		struct cg_view *view = seat_get_focus(server->seat);
+		if(view != NULL) {
+			copy_string(state->app_id, sizeof(state->app_id),
+			            view_get_app_id(view));
+			copy_string(state->title, sizeof(state->title),
+			            view->impl->get_title(view));
+		}
+	}
+}
+
+/* Publishes the current state if it changed, following the seqlock protocol
+ * described in snapshot.h */
+static void
+snapshot_update(struct cg_server *server) {
+	struct cg_snapshot *shm = server->snapshot->shm;
+	struct cg_snapshot_state state;
+	snapshot_collect(server, &state);
+	if(memcmp(&state, &shm->state, sizeof(state)) == 0) {
+		return;
+	}
+	uint32_t seq = atomic_load_explicit(&shm->seq, memory_order_relaxed);
+	atomic_store_explicit(&shm->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(&shm->state, &state, sizeof(state));
+	atomic_store_explicit(&shm->seq, seq + 2, memory_order_release);
+}
+
+static void
+handle_snapshot_idle(void *data) {
+	struct cg_server *server = data;
+	server->snapshot->idle = NULL;
+	snapshot_update(server);
+}
+
+/* Updates the snapshot once the event loop is done with the current events,
+ * so that bursts of changes only publish the final state. Does nothing until
+ * the first client asked for the snapshot. */
+void
+snapshot_schedule(struct cg_server *server) {
+	struct cg_snapshot_handle *snapshot = server->snapshot;
+	if(snapshot == NULL || snapshot->idle != NULL) {
+		return;
+	}
+	snapshot->idle =
+	    wl_event_loop_add_idle(server->event_loop, handle_snapshot_idle, server);
+}
+
+static struct cg_snapshot_handle *
+snapshot_create(struct cg_server *server) {
+	struct cg_snapshot_handle *snapshot = calloc(1, sizeof(*snapshot));
+	if(snapshot == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate the state snapshot");
+		return NULL;
+	}
+	size_t size = sizeof(struct cg_snapshot);
+	snapshot->fd =
+	    memfd_create("cagebreak-state", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if(snapshot->fd == -1) {
+		wlr_log_errno(WLR_ERROR, "Failed to create the state snapshot");
+		free(snapshot);
+		return NULL;
+	}
+	if(ftruncate(snapshot->fd, size) == -1) {
+		wlr_log_errno(WLR_ERROR, "Failed to size the state snapshot");
+		close(snapshot->fd);
+		free(snapshot);
+		return NULL;
+	}
+	snapshot->shm =
+	    mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, snapshot->fd, 0);
+	if(snapshot->shm == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "Failed to map the state snapshot");
+		close(snapshot->fd);
+		free(snapshot);
+		return NULL;
+	}
+
+	/* Readers can neither resize the memory nor, where supported, map it
+	 * writable */
+	int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+#ifdef F_SEAL_FUTURE_WRITE
+	seals |= F_SEAL_FUTURE_WRITE;
+#endif
+	if(fcntl(snapshot->fd, F_ADD_SEALS, seals) == -1) {
+		wlr_log_errno(WLR_ERROR, "Failed to seal the state snapshot");
+	}
+
+	snapshot->shm->magic = CG_SNAPSHOT_MAGIC;
+	snapshot->shm->version = CG_SNAPSHOT_VERSION;
+	snapshot->shm->size = size;
+	server->snapshot = snapshot;
+	snapshot_collect(server, &snapshot->shm->state);
+	return snapshot;
+}
+
+void
+snapshot_fini(struct cg_server *server) {
+	struct cg_snapshot_handle *snapshot = server->snapshot;
+	if(snapshot == NULL) {
+		return;
+	}
+	if(snapshot->idle != NULL) {
+		wl_event_source_remove(snapshot->idle);
+	}
+	munmap(snapshot->shm, sizeof(struct cg_snapshot));
+	close(snapshot->fd);
+	free(snapshot);
+	server->snapshot = NULL;
+}
+
+/* Sends the file descriptor of the snapshot to the IPC client running the
+ * command, creating the snapshot on first use */
+int
+snapshot_send(struct cg_server *server) {
+	if(server->ipc.current_client == NULL) {
+		wlr_log(WLR_ERROR, "\"snapshot\" only works over IPC");
+		return -1;
+	}
+	if(server->snapshot == NULL && snapshot_create(server) == NULL) {
+		return -1;
+	}
+	char reply[64];
+	int length = snprintf(reply, sizeof(reply),
+	                      "{\"snapshot\":{\"version\":%d,\"size\":%zu}}\n",
+	                      CG_SNAPSHOT_VERSION, sizeof(struct cg_snapshot));
+	return ipc_send_fd(server->ipc.current_client, server->snapshot->fd, reply,
+	                   length)
+	           ? 0
+	           : -1;
+}
@@ -0,0 +1,49 @@
+#ifndef CG_SNAPSHOT_H
+#define CG_SNAPSHOT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+struct cg_server;
+
+/* Layout of the shared memory handed out by the "snapshot" command. Readers
+ * map it read-only and copy the state like this:
+ *
+ *	do {
+ *		seq = atomic_load_explicit(&shm->seq, memory_order_acquire);
+ *		memcpy(&state, &shm->state, sizeof(state));
+ *		atomic_thread_fence(memory_order_acquire);
+ *	} while((seq & 1) ||
+ *	        seq != atomic_load_explicit(&shm->seq, memory_order_relaxed));
+ *
+ * Strings are NUL-terminated and truncated if needed. Fields are only ever
+ * appended, readers should check that version is at least the one they
+ * were written for. */
+#define CG_SNAPSHOT_MAGIC 0x53534743 // "CGSS"
+#define CG_SNAPSHOT_VERSION 1
+
+struct cg_snapshot_state {
+	char output[64];    // Name of the current output
+	uint32_t workspace; // Current workspace of that output, starting at 1
+	uint32_t nws;       // Number of workspaces
+	char mode[64];      // Mode the next key is looked up in
+	char app_id[128];   // App id of the focused view, empty without one
+	char title[256];    // Title of the focused view when it got focus
+};
+
+struct cg_snapshot {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;        // Size of the mapping
+	_Atomic uint32_t seq; // Odd while the state is being written
+	struct cg_snapshot_state state;
+};
+
+void
+snapshot_fini(struct cg_server *server);
+void
+snapshot_schedule(struct cg_server *server);
+int
+snapshot_send(struct cg_server *server);
+
+#endif
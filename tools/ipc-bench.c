@@ -0,0 +1,520 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+/* Load generator for the IPC socket. Opens a number of connections using
+ * the framed protocol, sends a mix of commands at a fixed rate and reports
+ * the throughput and the time until each command was answered. For
+ * repeatable numbers, run cagebreak on the headless backend:
+ *
+ *	WLR_BACKENDS=headless WLR_LIBINPUT_NO_DEVICES=1 cagebreak &
+ *	CAGEBREAK_SOCKET=... cagebreak-ipc-bench -c 100 -r 50 -d 10
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ipc_protocol.h"
+
+#define MAX_DEPTH 1024
+#define READ_BUFFER_SIZE 4096
+/* Time to wait for outstanding replies after the run, in seconds */
+#define DRAIN_TIMEOUT 5
+
+struct command_mix {
+	const char *name;
+	const char *const *commands;
+};
+
+static const char *const focus_commands[] = {"focus", "focusprev", "next",
+                                             "prev", NULL};
+/* Switching back and forth needs at least two workspaces, see "workspaces" in
+ * cagebreak-config(5) */
+static const char *const workspace_commands[] = {"workspace 1", "workspace 2",
+                                                 NULL};
+static const char *const split_commands[] = {"hsplit", "vsplit", "only", NULL};
+static const char *const message_commands[] = {"message ipc-bench", NULL};
+
+static const struct command_mix mixes[] = {
+    {"focus", focus_commands},
+    {"workspace", workspace_commands},
+    {"split", split_commands},
+    {"message", message_commands},
+};
+
+struct connection {
+	int fd;
+	uint32_t next_id;
+	uint32_t in_flight;
+	uint64_t next_send;          // in nanoseconds
+	uint64_t sent_at[MAX_DEPTH]; // indexed by request id
+	char buffer[READ_BUFFER_SIZE];
+	size_t buffer_len;
+	size_t skip; // Bytes of an oversized reply still to be dropped
+};
+
+struct bench {
+	struct connection *connections;
+	uint32_t nconnections;
+	const char **commands;
+	uint32_t ncommands;
+	uint32_t next_command;
+	uint32_t depth;
+	uint64_t interval; // between requests of a connection, 0 if unlimited
+
+	uint32_t *latencies; // in microseconds
+	size_t nlatencies;
+	size_t latencies_capacity;
+	uint64_t sent;
+	uint64_t errors;
+};
+
+static uint64_t
+now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void
+usage(FILE *file, const char *const cmd) {
+	fprintf(file,
+	        "Usage: %s [OPTIONS]\n"
+	        "\n"
+	        " -c <n>\t Open <n> connections (default 1)\n"
+	        " -d <s>\t Run for <s> seconds (default 10)\n"
+	        " -h\t Display this help message\n"
+	        " -m <mix>\t Comma separated command kinds out of focus, "
+	        "workspace, split\n"
+	        "\t and message (default all of them), workspace needs at least\n"
+	        "\t two workspaces\n"
+	        " -p <n>\t Allow <n> requests in flight per connection "
+	        "(default 1)\n"
+	        " -r <n>\t Send <n> requests per second and connection, 0 for "
+	        "as fast\n"
+	        "\t as possible (default 100)\n"
+	        " -s <path>\t Connect to <path> instead of $CAGEBREAK_SOCKET\n",
+	        cmd);
+}
+
+static bool
+parse_number(const char *str, long min, long max, long *value) {
+	char *end;
+	errno = 0;
+	*value = strtol(str, &end, 10);
+	return errno == 0 && end != str && *end == '\0' && *value >= min &&
+	       *value <= max;
+}
+
+static int
+add_mix(struct bench *bench, const char *name) {
+	for(size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); ++i) {
+		if(strcmp(mixes[i].name, name) != 0) {
+			continue;
+		}
+		for(const char *const *command = mixes[i].commands; *command != NULL;
+		    ++command) {
+			const char **commands =
+			    realloc(bench->commands,
+			            (bench->ncommands + 1) * sizeof(*bench->commands));
+			if(commands == NULL) {
+				fprintf(stderr, "Failed to allocate the command mix\n");
+				return -1;
+			}
+			bench->commands = commands;
+			bench->commands[bench->ncommands++] = *command;
+		}
+		return 0;
+	}
+	fprintf(stderr, "Unknown command kind \"%s\"\n", name);
+	return -1;
+}
+
+static int
+parse_mix(struct bench *bench, char *mix) {
+	char *saveptr;
+	for(char *name = strtok_r(mix, ",", &saveptr); name != NULL;
+	    name = strtok_r(NULL, ",", &saveptr)) {
+		if(add_mix(bench, name) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+connect_socket(const char *path) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path \"%s\" is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd == -1) {
+		perror("socket");
+		return -1;
+	}
+	if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		perror("connect");
+		close(fd);
+		return -1;
+	}
+	if(send(fd, IPC_FRAMED_MAGIC, IPC_FRAMED_MAGIC_SIZE, MSG_NOSIGNAL) !=
+	   IPC_FRAMED_MAGIC_SIZE) {
+		perror("send");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int
+send_request(struct bench *bench, struct connection *conn, uint64_t now) {
+	const char *command = bench->commands[bench->next_command];
+	bench->next_command = (bench->next_command + 1) % bench->ncommands;
+
+	char message[sizeof(struct cg_ipc_request) + 256];
+	struct cg_ipc_request header = {
+	    .length = strlen(command),
+	    .id = conn->next_id++,
+	};
+	memcpy(message, &header, sizeof(header));
+	memcpy(message + sizeof(header), command, header.length);
+	size_t length = sizeof(header) + header.length;
+
+	conn->sent_at[header.id % MAX_DEPTH] = now;
+	/* Requests are small and their number in flight is bounded, so the
+	 * socket buffer does not fill up */
+	if(send(conn->fd, message, length, MSG_NOSIGNAL) != (ssize_t)length) {
+		perror("send");
+		return -1;
+	}
+	++conn->in_flight;
+	++bench->sent;
+	return 0;
+}
+
+static int
+record_latency(struct bench *bench, uint64_t latency) {
+	if(bench->nlatencies == bench->latencies_capacity) {
+		size_t capacity = bench->latencies_capacity > 0
+		                      ? bench->latencies_capacity * 2
+		                      : 4096;
+		uint32_t *latencies =
+		    realloc(bench->latencies, capacity * sizeof(uint32_t));
+		if(latencies == NULL) {
+			fprintf(stderr, "Failed to allocate latency samples\n");
+			return -1;
+		}
+		bench->latencies = latencies;
+		bench->latencies_capacity = capacity;
+	}
+	uint64_t us = latency / 1000;
+	bench->latencies[bench->nlatencies++] = us < UINT32_MAX ? us : UINT32_MAX;
+	return 0;
+}
+
+static int
+handle_reply(struct bench *bench, struct connection *conn,
+             const struct cg_ipc_reply *reply, const char *payload,
+             size_t payload_len) {
+	if(conn->in_flight == 0) {
+		fprintf(stderr, "Unexpected reply %u\n", reply->id);
+		return -1;
+	}
+	--conn->in_flight;
+	if(reply->status != CG_IPC_STATUS_OK) {
+		++bench->errors;
+		if(bench->errors == 1) {
+			fprintf(stderr, "Request %u failed: %.*s\n", reply->id,
+			        (int)payload_len, payload);
+		}
+	}
+	uint64_t sent_at = conn->sent_at[reply->id % MAX_DEPTH];
+	return record_latency(bench, now_ns() - sent_at);
+}
+
+static int
+read_replies(struct bench *bench, struct connection *conn) {
+	ssize_t received =
+	    recv(conn->fd, conn->buffer + conn->buffer_len,
+	         sizeof(conn->buffer) - conn->buffer_len, 0);
+	if(received == -1) {
+		if(errno == EINTR || errno == EAGAIN) {
+			return 0;
+		}
+		perror("recv");
+		return -1;
+	}
+	if(received == 0) {
+		fprintf(stderr, "Connection closed by cagebreak\n");
+		return -1;
+	}
+	conn->buffer_len += received;
+
+	size_t offset = 0;
+	if(conn->skip > 0) {
+		offset = conn->skip < conn->buffer_len ? conn->skip : conn->buffer_len;
+		conn->skip -= offset;
+	}
+	struct cg_ipc_reply reply;
+	while(conn->buffer_len - offset >= sizeof(reply)) {
+		memcpy(&reply, conn->buffer + offset, sizeof(reply));
+		size_t available = conn->buffer_len - offset - sizeof(reply);
+		if(reply.length > sizeof(conn->buffer) - sizeof(reply)) {
+			/* Too large to buffer, only its status is of interest */
+			if(handle_reply(bench, conn, &reply, "", 0) != 0) {
+				return -1;
+			}
+			size_t dropped = available < reply.length ? available
+			                                          : reply.length;
+			conn->skip = reply.length - dropped;
+			offset += sizeof(reply) + dropped;
+			continue;
+		}
+		if(available < reply.length) {
+			break;
+		}
+		if(handle_reply(bench, conn, &reply,
+		                conn->buffer + offset + sizeof(reply),
+		                reply.length) != 0) {
+			return -1;
+		}
+		offset += sizeof(reply) + reply.length;
+	}
+	memmove(conn->buffer, conn->buffer + offset, conn->buffer_len - offset);
+	conn->buffer_len -= offset;
+	return 0;
+}
+
+static int
+compare_uint32(const void *a, const void *b) {
+	uint32_t ua = *(const uint32_t *)a, ub = *(const uint32_t *)b;
+	return ua < ub ? -1 : ua > ub;
+}
+
+static uint32_t
+percentile(const uint32_t *sorted, size_t n, int p) {
+	return sorted[(n * p + 99) / 100 - 1];
+}
+
+static void
+report(struct bench *bench, uint64_t elapsed) {
+	double seconds = elapsed / 1e9;
+	printf("connections: %u\n", bench->nconnections);
+	printf("requests:    %lu sent, %zu answered, %lu failed\n",
+	       (unsigned long)bench->sent, bench->nlatencies,
+	       (unsigned long)bench->errors);
+	printf("elapsed:     %.3f s\n", seconds);
+	printf("throughput:  %.1f requests/s\n", bench->nlatencies / seconds);
+	if(bench->nlatencies == 0) {
+		return;
+	}
+	qsort(bench->latencies, bench->nlatencies, sizeof(uint32_t),
+	      compare_uint32);
+	printf("latency:     p50 %u us, p90 %u us, p99 %u us, max %u us\n",
+	       percentile(bench->latencies, bench->nlatencies, 50),
+	       percentile(bench->latencies, bench->nlatencies, 90),
+	       percentile(bench->latencies, bench->nlatencies, 99),
+	       bench->latencies[bench->nlatencies - 1]);
+}
+
+static int
+run(struct bench *bench, uint64_t duration) {
+	struct pollfd *fds = calloc(bench->nconnections, sizeof(struct pollfd));
+	if(fds == NULL) {
+		fprintf(stderr, "Failed to allocate poll descriptors\n");
+		return -1;
+	}
+	for(uint32_t i = 0; i < bench->nconnections; ++i) {
+		fds[i].fd = bench->connections[i].fd;
+		fds[i].events = POLLIN;
+	}
+
+	int ret = 0;
+	uint64_t start = now_ns();
+	uint64_t end = start + duration;
+	uint64_t drain_end = end + DRAIN_TIMEOUT * 1000000000ULL;
+	for(uint32_t i = 0; i < bench->nconnections; ++i) {
+		/* Spread the connections over the first interval */
+		bench->connections[i].next_send =
+		    start + bench->interval * i / bench->nconnections;
+	}
+
+	for(;;) {
+		uint64_t now = now_ns();
+		bool sending = now < end;
+		uint64_t in_flight = 0;
+		uint64_t wakeup = sending ? end : drain_end;
+		for(uint32_t i = 0; i < bench->nconnections; ++i) {
+			struct connection *conn = &bench->connections[i];
+			if(sending && conn->in_flight < bench->depth &&
+			   conn->next_send <= now) {
+				if(send_request(bench, conn, now) != 0) {
+					ret = -1;
+					goto out;
+				}
+				/* Do not catch up with a burst after falling behind */
+				conn->next_send += bench->interval;
+				if(conn->next_send + bench->interval < now) {
+					conn->next_send = now;
+				}
+			}
+			if(sending && conn->in_flight < bench->depth &&
+			   conn->next_send < wakeup) {
+				wakeup = conn->next_send;
+			}
+			in_flight += conn->in_flight;
+		}
+		if(!sending && (in_flight == 0 || now >= drain_end)) {
+			break;
+		}
+
+		int timeout = wakeup > now ? (int)((wakeup - now + 999999) / 1000000)
+		                           : 0;
+		int ready = poll(fds, bench->nconnections, timeout);
+		if(ready == -1) {
+			if(errno == EINTR) {
+				continue;
+			}
+			perror("poll");
+			ret = -1;
+			goto out;
+		}
+		for(uint32_t i = 0; i < bench->nconnections && ready > 0; ++i) {
+			if(fds[i].revents == 0) {
+				continue;
+			}
+			--ready;
+			if(read_replies(bench, &bench->connections[i]) != 0) {
+				ret = -1;
+				goto out;
+			}
+		}
+	}
+
+out:
+	report(bench, now_ns() - start);
+	free(fds);
+	return ret;
+}
+
+int
+main(int argc, char *argv[]) {
+	struct bench bench = {0};
+	long connections = 1, duration = 10, depth = 1, rate = 100;
+	char *mix = NULL;
+	const char *path = getenv("CAGEBREAK_SOCKET");
+
+	int c;
+	while((c = getopt(argc, argv, "c:d:hm:p:r:s:")) != -1) {
+		switch(c) {
+		case 'c':
+			if(!parse_number(optarg, 1, 4096, &connections)) {
+				fprintf(stderr, "Invalid number of connections\n");
+				return 1;
+			}
+			break;
+		case 'd':
+			if(!parse_number(optarg, 1, 86400, &duration)) {
+				fprintf(stderr, "Invalid duration\n");
+				return 1;
+			}
+			break;
+		case 'h':
+			usage(stdout, argv[0]);
+			return 0;
+		case 'm':
+			mix = optarg;
+			break;
+		case 'p':
+			if(!parse_number(optarg, 1, MAX_DEPTH, &depth)) {
+				fprintf(stderr, "Invalid number of requests in flight\n");
+				return 1;
+			}
+			break;
+		case 'r':
+			if(!parse_number(optarg, 0, 1000000, &rate)) {
+				fprintf(stderr, "Invalid rate\n");
+				return 1;
+			}
+			break;
+		case 's':
+			path = optarg;
+			break;
+		default:
+			usage(stderr, argv[0]);
+			return 1;
+		}
+	}
+	if(optind < argc) {
+		usage(stderr, argv[0]);
+		return 1;
+	}
+	if(path == NULL) {
+		fprintf(stderr, "CAGEBREAK_SOCKET is not set, use -s\n");
+		return 1;
+	}
+
+	int ret = 1;
+	if(mix != NULL) {
+		if(parse_mix(&bench, mix) != 0) {
+			goto out;
+		}
+	} else {
+		for(size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); ++i) {
+			if(add_mix(&bench, mixes[i].name) != 0) {
+				goto out;
+			}
+		}
+	}
+	if(bench.ncommands == 0) {
+		fprintf(stderr, "No commands to send\n");
+		goto out;
+	}
+	bench.depth = depth;
+	bench.interval = rate > 0 ? 1000000000ULL / rate : 0;
+
+	bench.connections = calloc(connections, sizeof(struct connection));
+	if(bench.connections == NULL) {
+		fprintf(stderr, "Failed to allocate connections\n");
+		goto out;
+	}
+	for(; bench.nconnections < connections; ++bench.nconnections) {
+		struct connection *conn = &bench.connections[bench.nconnections];
+		conn->fd = connect_socket(path);
+		if(conn->fd == -1) {
+			goto out;
+		}
+	}
+
+	if(run(&bench, duration * 1000000000ULL) == 0) {
+		ret = 0;
+	}
+
+out:
+	for(uint32_t i = 0; i < bench.nconnections; ++i) {
+		close(bench.connections[i].fd);
+	}
+	free(bench.connections);
+	free(bench.commands);
+	free(bench.latencies);
+	return ret;
+}
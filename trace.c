@@ -0,0 +1,101 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+
+#include "ipc_server.h"
+#include "server.h"
+#include "trace.h"
+#include "util.h"
+
+#if CG_HAS_TRACING
+
+/* Number of events kept, older ones are overwritten. Must be a power of 2. */
+#define TRACE_RING_SIZE 16384
+
+struct cg_trace_event {
+	const char *name;
+	uint64_t start;    // in nanoseconds on CLOCK_MONOTONIC
+	uint64_t duration; // in nanoseconds
+};
+
+/* Events are only recorded on the main thread, so there is no locking */
+static struct cg_trace_event trace_ring[TRACE_RING_SIZE];
+static uint64_t trace_count; // Number of events recorded since startup
+
+void
+trace_record(const char *name, uint64_t start) {
+	struct cg_trace_event *event =
+	    &trace_ring[trace_count++ & (TRACE_RING_SIZE - 1)];
+	event->name = name;
+	event->start = start;
+	event->duration = monotonic_ns() - start;
+}
+
+/* Writes the recorded events, oldest first, as complete events in the Chrome
+ * trace event format, which Perfetto and chrome://tracing can load */
+static char *
+trace_to_json(size_t *length) {
+	char *json = NULL;
+	FILE *stream = open_memstream(&json, length);
+	if(stream == NULL) {
+		return NULL;
+	}
+	int pid = getpid();
+	uint64_t first =
+	    trace_count > TRACE_RING_SIZE ? trace_count - TRACE_RING_SIZE : 0;
+	fprintf(stream, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for(uint64_t i = first; i < trace_count; ++i) {
+		const struct cg_trace_event *event =
+		    &trace_ring[i & (TRACE_RING_SIZE - 1)];
+		fprintf(stream,
+		        "%s\n{\"name\":\"%s\",\"cat\":\"cagebreak\",\"ph\":\"X\","
+		        "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+		        i == first ? "" : ",", event->name, event->start / 1000.0,
+		        event->duration / 1000.0, pid, pid);
+	}
+	fprintf(stream, "\n]}\n");
+	if(fclose(stream) != 0) {
+		free(json);
+		return NULL;
+	}
+	return json;
+}
+
+/* Dumps the trace through ipc_send_result */
+int
+trace_dump(struct cg_server *server, const char *path) {
+	size_t length;
+	char *json = trace_to_json(&length);
+	if(json == NULL) {
+		wlr_log(WLR_ERROR, "Failed to serialize trace");
+		return -1;
+	}
+
+	int ret = ipc_send_result(server, path, json, length);
+	free(json);
+	return ret;
+}
+
+#else
+
+int
+trace_dump(struct cg_server *server, const char *path) {
+	wlr_log(WLR_ERROR, "Cagebreak was built without tracing support");
+	return -1;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef CG_TRACE_H
+#define CG_TRACE_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+#include "util.h"
+
+struct cg_server;
+
+/* Records how long the code between TRACE_BEGIN and TRACE_END took. name has
+ * to be a string literal. Without -Dtracing=true, both expand to nothing.
+ *
+ *	TRACE_BEGIN(start);
+ *	...
+ *	TRACE_END(start, "output.frame");
+ */
+#if CG_HAS_TRACING
+#define TRACE_BEGIN(start) uint64_t start = monotonic_ns()
+#define TRACE_END(start, name) trace_record(name, start)
+
+void
+trace_record(const char *name, uint64_t start);
+#else
+#define TRACE_BEGIN(start)
+#define TRACE_END(start, name)
+#endif
+
+int
+trace_dump(struct cg_server *server, const char *path);
+
+#endif
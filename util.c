@@ -7,10 +7,13 @@
  * See the LICENSE file accompanying this file.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <wlr/util/box.h>
 
 #include "util.h"
 #include <stdlib.h>
+#include <time.h>
 
 int
 scale_length(int length, int offset, double scale) {
@@ -53,3 +56,10 @@ malloc_vsprintf(const char *fmt, ...) {
 	char *ret = malloc_vsprintf_va_list(fmt, args);
 	return ret;
 }
+
+uint64_t
+monotonic_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
@@ -1,6 +1,7 @@
 #ifndef CG_UTIL_H
 #define CG_UTIL_H
 
+#include <stdint.h>
 #include <stdio.h>
 
 struct wlr_box;
@@ -17,4 +18,8 @@ malloc_vsprintf(const char *fmt, ...);
 char *
 malloc_vsprintf_va_list(const char *fmt, va_list list);
 
+/** Current time in nanoseconds on CLOCK_MONOTONIC. */
+uint64_t
+monotonic_ns(void);
+
 #endif
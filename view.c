@@ -18,6 +18,7 @@
 #include <wlr/types/wlr_surface.h>
 #include <wlr/util/box.h>
 
+#include "layout.h"
 #include "output.h"
 #include "seat.h"
 #include "server.h"
@@ -27,33 +28,86 @@
 #include "xwayland.h"
 #endif
 
+/* Returns the most recently hidden view of the workspace other than view */
 struct cg_view *
 view_get_prev_view(struct cg_view *view) {
-	struct cg_view *prev = NULL;
-
-	struct cg_view *it_view;
-	struct wl_list *it;
-	it = view->link.prev;
-	while(it != &view->link) {
-		if(it == &view->workspace->views) {
-			it = it->prev;
-			continue;
+	struct cg_view *it;
+	wl_list_for_each(it, &view->workspace->hidden_views, hidden_link) {
+		if(it != view) {
+			return it;
 		}
-		it_view = wl_container_of(it, it_view, link);
-		if(!view_is_visible(it_view)) {
-			prev = it_view;
-			break;
+	}
+	return NULL;
+}
+
+/* Brings the hidden view queue of the workspace of view in line with
+ * view_is_visible. This has to be called for every view which might have
+ * been shown or hidden. Views which became hidden are queued as the most
+ * recently hidden ones. */
+void
+view_update_hidden(struct cg_view *view) {
+	if(view == NULL) {
+		return;
+	}
+	bool queued = !wl_list_empty(&view->hidden_link);
+	bool hidden = view->wlr_surface != NULL && !view_is_visible(view);
+	if(hidden && !queued) {
+		wl_list_insert(&view->workspace->hidden_views, &view->hidden_link);
+	} else if(!hidden && queued) {
+		view_unqueue_hidden(view);
+	}
+}
+
+/* Removes view from the hidden view queue, this has to be done before it
+ * leaves its workspace */
+void
+view_unqueue_hidden(struct cg_view *view) {
+	wl_list_remove(&view->hidden_link);
+	wl_list_init(&view->hidden_link);
+}
+
+/* Computes the position of child relative to the surface of its view, returns
+ * false if it is unknown */
+static bool
+view_child_position(const struct cg_view_child *child, int *sx, int *sy) {
+	*sx = 0;
+	*sy = 0;
+	for(const struct cg_view_child *it = child; it != NULL; it = it->parent) {
+		if(it->get_position == NULL) {
+			return false;
 		}
-		it = it->prev;
+		int x, y;
+		it->get_position(it, &x, &y);
+		*sx += x;
+		*sy += y;
 	}
-	return prev;
+	return true;
 }
 
+/* Damages the surface of child alone. Its own children damage themselves. */
 void
 view_damage_child(struct cg_view_child *child, bool whole) {
-	if(child->view != NULL) {
-		view_damage_part(child->view);
+	struct cg_view *view = child->view;
+	if(view == NULL) {
+		return;
+	}
+	int sx, sy;
+	if(!view_child_position(child, &sx, &sy)) {
+		view_damage_part(view);
+		return;
 	}
+	struct cg_output *output = view->workspace->output;
+	if(sx != child->sx || sy != child->sy) {
+		/* The child moved, repaint where it was */
+		output_damage_single_surface(output, child->wlr_surface,
+		                             view->ox + child->sx, view->oy + child->sy,
+		                             true);
+		child->sx = sx;
+		child->sy = sy;
+		whole = true;
+	}
+	output_damage_single_surface(output, child->wlr_surface, view->ox + sx,
+	                             view->oy + sy, whole);
 }
 
 static void
@@ -100,13 +154,17 @@ view_child_finish(struct cg_view_child *child) {
 
 void
 view_child_init(struct cg_view_child *child, struct cg_view_child *parent,
-                struct cg_view *view, struct wlr_surface *wlr_surface) {
+                struct cg_view *view, struct wlr_surface *wlr_surface,
+                void (*get_position)(const struct cg_view_child *child,
+                                     int *sx, int *sy)) {
 	child->view = view;
 	child->parent = parent;
 	if(parent != NULL) {
 		wl_list_insert(&parent->children, &child->parent_link);
 	}
 	child->wlr_surface = wlr_surface;
+	child->get_position = get_position;
+	view_child_position(child, &child->sx, &child->sy);
 	wl_list_init(&child->children);
 
 	child->commit.notify = view_child_handle_commit;
@@ -117,6 +175,14 @@ view_child_init(struct cg_view_child *child, struct cg_view_child *parent,
 	wl_list_insert(&view->children, &child->link);
 }
 
+static void
+subsurface_get_position(const struct cg_view_child *child, int *sx, int *sy) {
+	const struct cg_subsurface *subsurface =
+	    (const struct cg_subsurface *)child;
+	*sx = subsurface->wlr_subsurface->current.x;
+	*sy = subsurface->wlr_subsurface->current.y;
+}
+
 static void
 subsurface_destroy(struct cg_view_child *child) {
 	if(!child) {
@@ -124,9 +190,10 @@ subsurface_destroy(struct cg_view_child *child) {
 	}
 
 	struct cg_subsurface *subsurface = (struct cg_subsurface *)child;
+	struct cg_server *server = child->view->server;
 	wl_list_remove(&subsurface->destroy.link);
 	view_child_finish(&subsurface->view_child);
-	free(subsurface);
+	pool_free(&server->subsurface_pool, subsurface);
 }
 
 static void
@@ -140,15 +207,15 @@ subsurface_handle_destroy(struct wl_listener *listener, void *_data) {
 static void
 subsurface_create(struct cg_view_child *parent, struct cg_view *view,
                   struct wlr_subsurface *wlr_subsurface) {
-	struct cg_subsurface *subsurface = calloc(1, sizeof(struct cg_subsurface));
+	struct cg_subsurface *subsurface = pool_alloc(&view->server->subsurface_pool);
 	if(!subsurface) {
 		return;
 	}
 
+	subsurface->wlr_subsurface = wlr_subsurface;
 	view_child_init(&subsurface->view_child, parent, view,
-	                wlr_subsurface->surface);
+	                wlr_subsurface->surface, subsurface_get_position);
 	subsurface->view_child.destroy = subsurface_destroy;
-	subsurface->wlr_subsurface = wlr_subsurface;
 
 	subsurface->destroy.notify = subsurface_handle_destroy;
 	wl_signal_add(&wlr_subsurface->events.destroy, &subsurface->destroy);
@@ -170,6 +237,12 @@ view_get_title(const struct cg_view *view) {
 	return strndup(title, strlen(title));
 }
 
+/* Returns the app id (or X11 class) of view, which is owned by the client */
+const char *
+view_get_app_id(const struct cg_view *view) {
+	return view->impl->get_app_id(view);
+}
+
 bool
 view_is_primary(const struct cg_view *view) {
 	return view->impl->is_primary(view);
@@ -185,6 +258,15 @@ view_get_tile(const struct cg_view *view) {
 	}
 }
 
+/* Stores the box covered by the main surface of view in output coordinates */
+void
+view_get_box(const struct cg_view *view, struct wlr_box *box) {
+	box->x = view->ox;
+	box->y = view->oy;
+	box->width = view->wlr_surface->current.width;
+	box->height = view->wlr_surface->current.height;
+}
+
 bool
 view_is_visible(const struct cg_view *view) {
 #if CG_HAS_XWAYLAND
@@ -212,6 +294,20 @@ view_damage_part(struct cg_view *view) {
 	view_damage(view, false);
 }
 
+/* Damages what the last commit changed on the main surface of the view.
+ * Subsurfaces and popups damage themselves when they commit. */
+void
+view_damage_commit(struct cg_view *view) {
+	struct cg_tile *view_tile = view_get_tile(view);
+	if(view_tile != NULL &&
+	   (view->wlr_surface->current.width != view_tile->tile.width ||
+	    view->wlr_surface->current.height != view_tile->tile.height)) {
+		view_maximize(view, view_tile);
+	}
+	output_damage_single_surface(view->workspace->output, view->wlr_surface,
+	                             view->ox, view->oy, false);
+}
+
 void
 view_damage_whole(struct cg_view *view) {
 	view_damage(view, true);
@@ -283,6 +379,7 @@ view_unmap(struct cg_view *view) {
 			view_tile->view = prev;
 			if(prev != NULL) {
 				view_maximize(prev, view_tile);
+				view_update_hidden(prev);
 			}
 		}
 	}
@@ -299,9 +396,15 @@ view_unmap(struct cg_view *view) {
 #endif
 
 	wl_list_remove(&view->link);
+	view_unqueue_hidden(view);
 
 	wl_list_remove(&view->new_subsurface.link);
 	view->wlr_surface = NULL;
+#if CG_HAS_XWAYLAND
+	if(view->type == CG_XWAYLAND_VIEW && !xwayland_view_should_manage(view)) {
+		workspace_update_unmanaged_box(view->workspace);
+	}
+#endif
 }
 
 void
@@ -332,9 +435,15 @@ view_map(struct cg_view *view, struct wlr_surface *surface,
 	   their own (x,y) coordinates in handle_wayland_surface_map. */
 	if(view->type == CG_XWAYLAND_VIEW && !xwayland_view_should_manage(view)) {
 		wl_list_insert(&ws->unmanaged_views, &view->link);
+		workspace_update_unmanaged_box(ws);
 	} else
 #endif
 	{
+		/* A tile restored from a layout may be waiting for this view */
+		struct cg_tile *tile = layout_match_view(ws, view);
+		if(tile != NULL) {
+			ws->focused_tile = tile;
+		}
 		view->tile = view->workspace->focused_tile;
 		view_maximize(view, view->tile);
 		wl_list_insert(&ws->views, &view->link);
@@ -365,6 +474,7 @@ view_init(struct cg_view *view, enum cg_view_type type,
 	view->impl = impl;
 
 	wl_list_init(&view->children);
+	wl_list_init(&view->hidden_link);
 }
 
 struct wlr_surface *
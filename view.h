@@ -22,6 +22,7 @@ struct cg_view {
 	struct cg_server *server;
 	struct wl_list link;     // server::views
 	struct wl_list children; // cg_view_child::link
+	struct wl_list hidden_link; // cg_workspace::hidden_views
 	struct wlr_surface *wlr_surface;
 	struct cg_tile *tile;
 
@@ -36,6 +37,7 @@ struct cg_view {
 
 struct cg_view_impl {
 	char *(*get_title)(const struct cg_view *view);
+	char *(*get_app_id)(const struct cg_view *view);
 	bool (*is_primary)(const struct cg_view *view);
 	void (*activate)(struct cg_view *view, bool activate);
 	void (*close)(struct cg_view *view);
@@ -61,7 +63,14 @@ struct cg_view_child {
 	struct wl_listener commit;
 	struct wl_listener new_subsurface;
 
+	/* Position relative to the surface of the view as of the last commit */
+	int sx, sy;
+
 	void (*destroy)(struct cg_view_child *child);
+	/* Returns the position relative to the surface of the parent, or of the
+	 * view if there is no parent. NULL if it is unknown. */
+	void (*get_position)(const struct cg_view_child *child, int *sx,
+	                     int *sy);
 };
 
 struct cg_subsurface {
@@ -73,6 +82,8 @@ struct cg_subsurface {
 
 char *
 view_get_title(const struct cg_view *view);
+const char *
+view_get_app_id(const struct cg_view *view);
 struct cg_tile *
 view_get_tile(const struct cg_view *view);
 bool
@@ -80,10 +91,14 @@ view_is_primary(const struct cg_view *view);
 bool
 view_is_visible(const struct cg_view *view);
 void
+view_get_box(const struct cg_view *view, struct wlr_box *box);
+void
 view_damage_part(struct cg_view *view);
 void
 view_damage_whole(struct cg_view *view);
 void
+view_damage_commit(struct cg_view *view);
+void
 view_damage_child(struct cg_view_child *view, bool whole);
 void
 view_activate(struct cg_view *view, bool activate);
@@ -114,8 +129,14 @@ void
 view_child_finish(struct cg_view_child *child);
 void
 view_child_init(struct cg_view_child *child, struct cg_view_child *parent,
-                struct cg_view *view, struct wlr_surface *wlr_surface);
+                struct cg_view *view, struct wlr_surface *wlr_surface,
+                void (*get_position)(const struct cg_view_child *child,
+                                     int *sx, int *sy));
 struct cg_view *
 view_get_prev_view(struct cg_view *view);
+void
+view_update_hidden(struct cg_view *view);
+void
+view_unqueue_hidden(struct cg_view *view);
 
 #endif
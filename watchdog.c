@@ -0,0 +1,212 @@
+/*
+ * Cagebreak: A Wayland tiling compositor.
+ *
+ * Copyright (C) 2020-2022 The Cagebreak Authors
+ *
+ * See the LICENSE file accompanying this file.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+
+#include "ipc_server.h"
+#include "server.h"
+#include "util.h"
+#include "watchdog.h"
+
+#define WATCHDOG_DEFAULT_BUDGET_MS 50
+#define WATCHDOG_CONTEXT_SIZE 128
+/* Slow handlers are reported at most once per second and kind */
+#define WATCHDOG_REPORT_INTERVAL_NS 1000000000ULL
+
+struct cg_watchdog_stats {
+	uint64_t calls;
+	uint64_t over_budget;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t last_report; // When the last report was logged, in nanoseconds
+	uint64_t suppressed;  // Slow dispatches not reported since then
+	char max_context[WATCHDOG_CONTEXT_SIZE];
+};
+
+struct cg_watchdog {
+	uint64_t budget_ns; // 0 disables the reports
+	uint32_t depth;     // Number of handlers currently being dispatched
+	/* What the outermost handler is doing, e.g. the IPC command it runs */
+	char context[WATCHDOG_CONTEXT_SIZE];
+	struct cg_watchdog_stats stats[CG_WATCHDOG_HANDLERS];
+};
+
+static const char *const handler_names[CG_WATCHDOG_HANDLERS] = {
+    [CG_WATCHDOG_KEY] = "key",       [CG_WATCHDOG_BUTTON] = "button",
+    [CG_WATCHDOG_MOTION] = "motion", [CG_WATCHDOG_IPC] = "ipc",
+    [CG_WATCHDOG_FRAME] = "frame",   [CG_WATCHDOG_COMMIT] = "commit",
+    [CG_WATCHDOG_MAP] = "map",       [CG_WATCHDOG_OUTPUT] = "output",
+};
+
+int
+watchdog_init(struct cg_server *server) {
+	server->watchdog = calloc(1, sizeof(struct cg_watchdog));
+	if(server->watchdog == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate the watchdog");
+		return -1;
+	}
+	server->watchdog->budget_ns = WATCHDOG_DEFAULT_BUDGET_MS * 1000000ULL;
+	return 0;
+}
+
+void
+watchdog_fini(struct cg_server *server) {
+	free(server->watchdog);
+	server->watchdog = NULL;
+}
+
+/* Returns the start time to be passed to watchdog_end once the handler is
+ * done. Handlers may be nested, e.g. an output mode change caused by an IPC
+ * command. */
+uint64_t
+watchdog_begin(struct cg_server *server) {
+	if(server->watchdog == NULL) {
+		return 0;
+	}
+	++server->watchdog->depth;
+	return monotonic_ns();
+}
+
+static void
+watchdog_report(struct cg_watchdog *watchdog, enum cg_watchdog_handler handler,
+                uint64_t duration, uint64_t now) {
+	struct cg_watchdog_stats *stats = &watchdog->stats[handler];
+	if(stats->last_report != 0 &&
+	   now - stats->last_report < WATCHDOG_REPORT_INTERVAL_NS) {
+		++stats->suppressed;
+		return;
+	}
+	wlr_log(WLR_ERROR,
+	        "Watchdog: %s handler blocked the event loop for %.1f ms (budget "
+	        "%.1f ms) while handling %s, %" PRIu64 " of %" PRIu64
+	        " dispatches over budget, %" PRIu64 " unreported since the last "
+	        "report",
+	        handler_names[handler], duration / 1e6,
+	        watchdog->budget_ns / 1e6,
+	        watchdog->context[0] != '\0' ? watchdog->context : "an unknown event",
+	        stats->over_budget, stats->calls, stats->suppressed);
+	stats->last_report = now;
+	stats->suppressed = 0;
+}
+
+void
+watchdog_end(struct cg_server *server, enum cg_watchdog_handler handler,
+             uint64_t start) {
+	struct cg_watchdog *watchdog = server->watchdog;
+	if(watchdog == NULL) {
+		return;
+	}
+	uint64_t now = monotonic_ns();
+	uint64_t duration = now - start;
+	struct cg_watchdog_stats *stats = &watchdog->stats[handler];
+	++stats->calls;
+	stats->total_ns += duration;
+	if(duration > stats->max_ns) {
+		stats->max_ns = duration;
+		memcpy(stats->max_context, watchdog->context,
+		       sizeof(stats->max_context));
+	}
+	if(watchdog->budget_ns > 0 && duration > watchdog->budget_ns) {
+		++stats->over_budget;
+		watchdog_report(watchdog, handler, duration, now);
+	}
+	if(--watchdog->depth == 0) {
+		watchdog->context[0] = '\0';
+	}
+}
+
+/* Describes what the outermost handler being dispatched is doing, for the
+ * reports of the watchdog. Nested handlers leave the description alone. */
+void
+watchdog_context(struct cg_server *server, const char *fmt, ...) {
+	struct cg_watchdog *watchdog = server->watchdog;
+	if(watchdog == NULL || watchdog->depth != 1) {
+		return;
+	}
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(watchdog->context, sizeof(watchdog->context), fmt, args);
+	va_end(args);
+}
+
+void
+watchdog_set_budget(struct cg_server *server, uint32_t budget_ms) {
+	if(server->watchdog != NULL) {
+		server->watchdog->budget_ns = budget_ms * 1000000ULL;
+	}
+}
+
+/* Prints str as a JSON string */
+static void
+print_json_string(FILE *stream, const char *str) {
+	fputc('"', stream);
+	for(const unsigned char *c = (const unsigned char *)str; *c != '\0'; ++c) {
+		if(*c == '"' || *c == '\\') {
+			fprintf(stream, "\\%c", *c);
+		} else if(*c < 0x20) {
+			fprintf(stream, "\\u%04x", *c);
+		} else {
+			fputc(*c, stream);
+		}
+	}
+	fputc('"', stream);
+}
+
+static char *
+watchdog_to_json(const struct cg_watchdog *watchdog, size_t *length) {
+	char *json = NULL;
+	FILE *stream = open_memstream(&json, length);
+	if(stream == NULL) {
+		return NULL;
+	}
+	fprintf(stream, "{\"budget_ms\":%.3f,\"handlers\":{",
+	        watchdog->budget_ns / 1e6);
+	for(int i = 0; i < CG_WATCHDOG_HANDLERS; ++i) {
+		const struct cg_watchdog_stats *stats = &watchdog->stats[i];
+		fprintf(stream,
+		        "%s\"%s\":{\"calls\":%" PRIu64 ",\"over_budget\":%" PRIu64
+		        ",\"total_ms\":%.3f,\"max_ms\":%.3f,\"max_context\":",
+		        i == 0 ? "" : ",", handler_names[i], stats->calls,
+		        stats->over_budget, stats->total_ns / 1e6,
+		        stats->max_ns / 1e6);
+		print_json_string(stream, stats->max_context);
+		fprintf(stream, "}");
+	}
+	fprintf(stream, "}}\n");
+	if(fclose(stream) != 0) {
+		free(json);
+		return NULL;
+	}
+	return json;
+}
+
+/* Dumps the dispatch time counters as JSON through ipc_send_result */
+int
+watchdog_dump(struct cg_server *server, const char *path) {
+	if(server->watchdog == NULL) {
+		wlr_log(WLR_ERROR, "No watchdog statistics available");
+		return -1;
+	}
+	size_t length;
+	char *json = watchdog_to_json(server->watchdog, &length);
+	if(json == NULL) {
+		wlr_log(WLR_ERROR, "Failed to serialize watchdog statistics");
+		return -1;
+	}
+	int ret = ipc_send_result(server, path, json, length);
+	free(json);
+	return ret;
+}
@@ -0,0 +1,37 @@
+#ifndef CG_WATCHDOG_H
+#define CG_WATCHDOG_H
+
+#include <stdint.h>
+
+struct cg_server;
+
+/* Kinds of event loop handlers whose dispatch time is measured */
+enum cg_watchdog_handler {
+	CG_WATCHDOG_KEY,
+	CG_WATCHDOG_BUTTON,
+	CG_WATCHDOG_MOTION,
+	CG_WATCHDOG_IPC,
+	CG_WATCHDOG_FRAME,
+	CG_WATCHDOG_COMMIT,
+	CG_WATCHDOG_MAP,
+	CG_WATCHDOG_OUTPUT,
+	CG_WATCHDOG_HANDLERS,
+};
+
+int
+watchdog_init(struct cg_server *server);
+void
+watchdog_fini(struct cg_server *server);
+uint64_t
+watchdog_begin(struct cg_server *server);
+void
+watchdog_end(struct cg_server *server, enum cg_watchdog_handler handler,
+             uint64_t start);
+void
+watchdog_context(struct cg_server *server, const char *fmt, ...);
+void
+watchdog_set_budget(struct cg_server *server, uint32_t budget_ms);
+int
+watchdog_dump(struct cg_server *server, const char *path);
+
+#endif
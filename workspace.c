@@ -17,6 +17,7 @@
 #include "message.h"
 #include "output.h"
 #include "server.h"
+#include "view.h"
 #include "workspace.h"
 
 #if CG_HAS_FANALYZE
@@ -27,7 +28,7 @@ int
 full_screen_workspace_tiles(struct wlr_output_layout *layout,
                             struct wlr_output *output,
                             struct cg_workspace *workspace) {
-	workspace->focused_tile = calloc(1, sizeof(struct cg_tile));
+	workspace->focused_tile = pool_alloc(&workspace->server->tile_pool);
 	if(!workspace->focused_tile) {
 		return -1;
 	}
@@ -53,6 +54,9 @@ full_screen_workspace(struct cg_output *output) {
 		return NULL;
 	}
 	workspace->server = output->server;
+	wl_list_init(&workspace->views);
+	wl_list_init(&workspace->unmanaged_views);
+	wl_list_init(&workspace->hidden_views);
 	if(full_screen_workspace_tiles(output->server->output_layout,
 	                               output->wlr_output, workspace) != 0) {
 		free(workspace);
@@ -65,14 +69,145 @@ full_screen_workspace(struct cg_output *output) {
 void
 workspace_focus_tile(struct cg_workspace *ws, struct cg_tile *tile) {
 	ws->focused_tile = tile;
-	struct wlr_box *box = malloc(sizeof(struct wlr_box));
-	if(!box) {
-		wlr_log(WLR_ERROR, "Failed to allocate box required to focus tile");
-		return;
+	struct wlr_box box = {.x = tile->tile.x + tile->tile.width / 2,
+	                      .y = tile->tile.y + tile->tile.height / 2};
+	message_printf_pos(ws->output, &box, CG_MESSAGE_CENTER, "Current frame");
+}
+
+static void
+tile_free_neighbours(struct cg_tile *tile) {
+	for(int dir = 0; dir < CG_TILE_DIRECTIONS; ++dir) {
+		free(tile->neighbours[dir].tiles);
+		tile->neighbours[dir].tiles = NULL;
+		tile->neighbours[dir].length = 0;
+		tile->neighbours[dir].best = NULL;
+	}
+}
+
+/* Returns the length of the part of the edge of tile in direction dir which
+ * is shared with other, or 0 if the tiles are not adjacent in that direction
+ */
+static int
+tile_shared_edge(const struct cg_tile *tile, const struct cg_tile *other,
+                 enum cg_tile_direction dir) {
+	const struct wlr_box *a = &tile->tile, *b = &other->tile;
+	int start, end;
+	switch(dir) {
+	case CG_TILE_LEFT:
+	case CG_TILE_RIGHT:
+		if((dir == CG_TILE_LEFT && b->x + b->width != a->x) ||
+		   (dir == CG_TILE_RIGHT && a->x + a->width != b->x)) {
+			return 0;
+		}
+		start = a->y > b->y ? a->y : b->y;
+		end = a->y + a->height < b->y + b->height ? a->y + a->height
+		                                          : b->y + b->height;
+		break;
+	case CG_TILE_TOP:
+	case CG_TILE_BOTTOM:
+		if((dir == CG_TILE_TOP && b->y + b->height != a->y) ||
+		   (dir == CG_TILE_BOTTOM && a->y + a->height != b->y)) {
+			return 0;
+		}
+		start = a->x > b->x ? a->x : b->x;
+		end = a->x + a->width < b->x + b->width ? a->x + a->width
+		                                        : b->x + b->width;
+		break;
+	default:
+		return 0;
 	}
-	box->x = tile->tile.x + tile->tile.width / 2;
-	box->y = tile->tile.y + tile->tile.height / 2;
-	message_printf_pos(ws->output, box, CG_MESSAGE_CENTER, "Current frame");
+	return end > start ? end - start : 0;
+}
+
+/* Neighbours do not overlap along the edge they share with a tile, so
+ * ordering them by their start on it (y for left/right, x for top/bottom)
+ * orders them along the edge */
+static int
+compare_tiles_by_y(const void *a, const void *b) {
+	const struct cg_tile *ta = *(struct cg_tile *const *)a;
+	const struct cg_tile *tb = *(struct cg_tile *const *)b;
+	return (ta->tile.y > tb->tile.y) - (ta->tile.y < tb->tile.y);
+}
+
+static int
+compare_tiles_by_x(const void *a, const void *b) {
+	const struct cg_tile *ta = *(struct cg_tile *const *)a;
+	const struct cg_tile *tb = *(struct cg_tile *const *)b;
+	return (ta->tile.x > tb->tile.x) - (ta->tile.x < tb->tile.x);
+}
+
+/* Recomputes the neighbour graph of the workspace. This has to be called
+ * whenever tiles are added, removed or resized. */
+void
+workspace_update_neighbours(struct cg_workspace *ws) {
+	struct cg_tile *tile = ws->focused_tile;
+	do {
+		tile_free_neighbours(tile);
+		for(int dir = 0; dir < CG_TILE_DIRECTIONS; ++dir) {
+			struct cg_tile_neighbours *neighbours = &tile->neighbours[dir];
+			uint32_t count = 0;
+			for(struct cg_tile *it = tile->next; it != tile; it = it->next) {
+				if(tile_shared_edge(tile, it, dir) > 0) {
+					++count;
+				}
+			}
+			if(count == 0) {
+				continue;
+			}
+			neighbours->tiles = malloc(count * sizeof(struct cg_tile *));
+			if(neighbours->tiles == NULL) {
+				wlr_log(WLR_ERROR, "Failed to allocate tile neighbours");
+				continue;
+			}
+			int best_shared = 0;
+			for(struct cg_tile *it = tile->next; it != tile; it = it->next) {
+				int shared = tile_shared_edge(tile, it, dir);
+				if(shared > 0) {
+					neighbours->tiles[neighbours->length++] = it;
+					if(shared > best_shared) {
+						best_shared = shared;
+						neighbours->best = it;
+					}
+				}
+			}
+			bool horizontal = dir == CG_TILE_LEFT || dir == CG_TILE_RIGHT;
+			qsort(neighbours->tiles, neighbours->length,
+			      sizeof(struct cg_tile *),
+			      horizontal ? compare_tiles_by_y : compare_tiles_by_x);
+		}
+		tile = tile->next;
+	} while(tile != ws->focused_tile);
+}
+
+/* Returns the neighbour of tile in direction dir, or NULL if there is none.
+ * If the cursor (in output coordinates) is inside tile, the neighbour next
+ * to the cursor is chosen, otherwise the one sharing the longest edge. */
+struct cg_tile *
+tile_find_neighbour(const struct cg_tile *tile, enum cg_tile_direction dir,
+                    double cursor_x, double cursor_y) {
+	const struct cg_tile_neighbours *neighbours = &tile->neighbours[dir];
+	if(neighbours->length <= 1 ||
+	   !wlr_box_contains_point(&tile->tile, cursor_x, cursor_y)) {
+		return neighbours->best;
+	}
+	bool horizontal = dir == CG_TILE_LEFT || dir == CG_TILE_RIGHT;
+	double pos = horizontal ? cursor_y : cursor_x;
+	/* The neighbours are sorted along the edge */
+	uint32_t low = 0, high = neighbours->length;
+	while(low < high) {
+		uint32_t mid = low + (high - low) / 2;
+		const struct wlr_box *box = &neighbours->tiles[mid]->tile;
+		int start = horizontal ? box->y : box->x;
+		int end = start + (horizontal ? box->height : box->width);
+		if(pos < start) {
+			high = mid;
+		} else if(pos >= end) {
+			low = mid + 1;
+		} else {
+			return neighbours->tiles[mid];
+		}
+	}
+	return neighbours->best;
 }
 
 void
@@ -80,9 +215,52 @@ workspace_free_tiles(struct cg_workspace *workspace) {
 	workspace->focused_tile->prev->next = NULL;
 	while(workspace->focused_tile != NULL) {
 		struct cg_tile *next = workspace->focused_tile->next;
-		free(workspace->focused_tile);
+		tile_free_neighbours(workspace->focused_tile);
+		free(workspace->focused_tile->app_id_rule);
+		free(workspace->focused_tile->title_rule);
+		pool_free(&workspace->server->tile_pool, workspace->focused_tile);
 		workspace->focused_tile = next;
 	}
+	workspace->tile_rules = 0;
+}
+
+/* A workspace is empty if it has neither views nor a tiling layout */
+bool
+workspace_is_empty(const struct cg_workspace *workspace) {
+	return wl_list_empty(&workspace->views) &&
+	       wl_list_empty(&workspace->unmanaged_views) &&
+	       workspace->focused_tile->next == workspace->focused_tile;
+}
+
+/* Recomputes the bounding box of the unmanaged views. This has to be called
+ * whenever one is added, removed, moved or resized. */
+void
+workspace_update_unmanaged_box(struct cg_workspace *workspace) {
+	struct wlr_box *bounds = &workspace->unmanaged_box;
+	*bounds = (struct wlr_box){0};
+	struct cg_view *view;
+	wl_list_for_each(view, &workspace->unmanaged_views, link) {
+		struct wlr_box box;
+		view_get_box(view, &box);
+		if(wlr_box_empty(&box)) {
+			continue;
+		}
+		if(wlr_box_empty(bounds)) {
+			*bounds = box;
+			continue;
+		}
+		int x2 = bounds->x + bounds->width, y2 = bounds->y + bounds->height;
+		if(box.x + box.width > x2) {
+			x2 = box.x + box.width;
+		}
+		if(box.y + box.height > y2) {
+			y2 = box.y + box.height;
+		}
+		bounds->x = box.x < bounds->x ? box.x : bounds->x;
+		bounds->y = box.y < bounds->y ? box.y : bounds->y;
+		bounds->width = x2 - bounds->x;
+		bounds->height = y2 - bounds->y;
+	}
 }
 
 void
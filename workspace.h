@@ -1,26 +1,53 @@
 #ifndef CG_WORKSPACE_H
 #define CG_WORKSPACE_H
 
+#include <stdint.h>
 #include <wlr/util/box.h>
 
 struct cg_output;
 struct cg_server;
 
+enum cg_tile_direction {
+	CG_TILE_LEFT,
+	CG_TILE_RIGHT,
+	CG_TILE_TOP,
+	CG_TILE_BOTTOM,
+	CG_TILE_DIRECTIONS,
+};
+
+/* Tiles sharing an edge with a tile, see workspace_update_neighbours */
+struct cg_tile_neighbours {
+	struct cg_tile **tiles; // Sorted along the shared edge
+	uint32_t length;
+	struct cg_tile *best; // The neighbour sharing the longest part of the edge
+};
+
 struct cg_tile {
 	struct cg_workspace *workspace;
 	struct wlr_box tile;
 	struct cg_view *view;
 	struct cg_tile *next;
 	struct cg_tile *prev;
+	struct cg_tile_neighbours neighbours[CG_TILE_DIRECTIONS];
+	/* Set by restorelayout, the first view mapped with this app id or title
+	 * is shown in the tile */
+	char *app_id_rule;
+	char *title_rule;
 };
 
 struct cg_workspace {
 	struct cg_server *server;
 	struct wl_list views;
+	/* Topmost first. unmanaged_box bounds all of them in output coordinates
+	 * so that hit-testing and rendering can skip them at once. */
 	struct wl_list unmanaged_views;
+	struct wlr_box unmanaged_box;
+	/* Managed views not shown in any tile, most recently hidden first */
+	struct wl_list hidden_views; // cg_view::hidden_link
 	struct cg_output *output;
 
 	struct cg_tile *focused_tile;
+	uint32_t tile_rules; // Number of tiles with an app id or title rule
 };
 
 struct cg_workspace *
@@ -31,9 +58,18 @@ full_screen_workspace_tiles(struct wlr_output_layout *layout,
                             struct cg_workspace *workspace);
 void
 workspace_free_tiles(struct cg_workspace *workspace);
+bool
+workspace_is_empty(const struct cg_workspace *workspace);
+void
+workspace_update_unmanaged_box(struct cg_workspace *workspace);
 void
 workspace_free(struct cg_workspace *workspace);
 void
 workspace_focus_tile(struct cg_workspace *ws, struct cg_tile *tile);
+void
+workspace_update_neighbours(struct cg_workspace *ws);
+struct cg_tile *
+tile_find_neighbour(const struct cg_tile *tile, enum cg_tile_direction dir,
+                    double cursor_x, double cursor_y);
 
 #endif
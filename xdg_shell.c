@@ -18,9 +18,12 @@
 #include <wlr/util/edges.h>
 #include <wlr/util/log.h>
 
+#include "latency.h"
 #include "output.h"
 #include "server.h"
+#include "trace.h"
 #include "view.h"
+#include "watchdog.h"
 #include "workspace.h"
 #include "xdg_shell.h"
 
@@ -52,6 +55,18 @@ xdg_decoration_handle_request_mode(struct wl_listener *listener, void *_data) {
 #pragma GCC diagnostic pop
 #endif
 
+static void
+xdg_popup_get_position(const struct cg_view_child *child, int *sx, int *sy) {
+	const struct cg_xdg_popup *popup = (const struct cg_xdg_popup *)child;
+	struct wlr_xdg_popup *wlr_popup = popup->wlr_popup;
+	double x, y;
+	wlr_xdg_popup_get_toplevel_coords(
+	    wlr_popup, wlr_popup->geometry.x - wlr_popup->base->geometry.x,
+	    wlr_popup->geometry.y - wlr_popup->base->geometry.y, &x, &y);
+	*sx = x;
+	*sy = y;
+}
+
 static void
 xdg_popup_destroy(struct cg_view_child *child) {
 	if(!child) {
@@ -60,12 +75,13 @@ xdg_popup_destroy(struct cg_view_child *child) {
 
 	view_damage_child(child, true);
 	struct cg_xdg_popup *popup = (struct cg_xdg_popup *)child;
+	struct cg_server *server = child->view->server;
 	wl_list_remove(&popup->destroy.link);
 	wl_list_remove(&popup->map.link);
 	wl_list_remove(&popup->unmap.link);
 	wl_list_remove(&popup->new_popup.link);
 	view_child_finish(&popup->view_child);
-	free(popup);
+	pool_free(&server->popup_pool, popup);
 }
 
 static void
@@ -121,13 +137,14 @@ popup_unconstrain(struct cg_xdg_popup *popup) {
 
 static void
 xdg_popup_create(struct cg_view *view, struct wlr_xdg_popup *wlr_popup) {
-	struct cg_xdg_popup *popup = calloc(1, sizeof(struct cg_xdg_popup));
+	struct cg_xdg_popup *popup = pool_alloc(&view->server->popup_pool);
 	if(!popup) {
 		return;
 	}
 
 	popup->wlr_popup = wlr_popup;
-	view_child_init(&popup->view_child, NULL, view, wlr_popup->base->surface);
+	view_child_init(&popup->view_child, NULL, view, wlr_popup->base->surface,
+	                xdg_popup_get_position);
 	popup->view_child.destroy = xdg_popup_destroy;
 	popup->destroy.notify = handle_xdg_popup_destroy;
 	wl_signal_add(&wlr_popup->base->events.destroy, &popup->destroy);
@@ -166,6 +183,13 @@ get_title(const struct cg_view *view) {
 	return xdg_shell_view->xdg_surface->toplevel->title;
 }
 
+static char *
+get_app_id(const struct cg_view *view) {
+	const struct cg_xdg_shell_view *xdg_shell_view =
+	    xdg_shell_view_from_const_view(view);
+	return xdg_shell_view->xdg_surface->toplevel->app_id;
+}
+
 static bool
 is_primary(const struct cg_view *view) {
 	const struct cg_xdg_shell_view *xdg_shell_view =
@@ -192,12 +216,33 @@ close(struct cg_view *view) {
 }
 
 static void
-maximize(struct cg_view *view, int width, int height) {
-	struct cg_xdg_shell_view *xdg_shell_view = xdg_shell_view_from_view(view);
-	wlr_xdg_toplevel_set_size(xdg_shell_view->xdg_surface, width, height);
+configure_size(struct cg_xdg_shell_view *xdg_shell_view, int width,
+               int height) {
+	uint32_t serial =
+	    wlr_xdg_toplevel_set_size(xdg_shell_view->xdg_surface, width, height);
 	enum wlr_edges edges =
 	    WLR_EDGE_LEFT | WLR_EDGE_RIGHT | WLR_EDGE_TOP | WLR_EDGE_BOTTOM;
-	wlr_xdg_toplevel_set_tiled(xdg_shell_view->xdg_surface, edges);
+	uint32_t tiled_serial =
+	    wlr_xdg_toplevel_set_tiled(xdg_shell_view->xdg_surface, edges);
+	xdg_shell_view->configure_serial = tiled_serial != 0 ? tiled_serial : serial;
+	xdg_shell_view->configure_acked = false;
+	xdg_shell_view->configure_width = width;
+	xdg_shell_view->configure_height = height;
+}
+
+static void
+maximize(struct cg_view *view, int width, int height) {
+	struct cg_xdg_shell_view *xdg_shell_view = xdg_shell_view_from_view(view);
+	if(xdg_shell_view->configure_serial == 0) {
+		configure_size(xdg_shell_view, width, height);
+		return;
+	}
+	/* Wait for the client to catch up with the resize in flight */
+	xdg_shell_view->resize_pending =
+	    width != xdg_shell_view->configure_width ||
+	    height != xdg_shell_view->configure_height;
+	xdg_shell_view->pending_width = width;
+	xdg_shell_view->pending_height = height;
 }
 
 static void
@@ -241,12 +286,40 @@ handle_xdg_shell_surface_request_fullscreen(struct wl_listener *listener,
 	                                event->fullscreen);
 }
 
+static void
+handle_xdg_shell_surface_ack_configure(struct wl_listener *listener,
+                                       void *data) {
+	struct cg_xdg_shell_view *xdg_shell_view =
+	    wl_container_of(listener, xdg_shell_view, ack_configure);
+	struct wlr_xdg_surface_configure *configure = data;
+	if(xdg_shell_view->configure_serial != 0 &&
+	   (int32_t)(configure->serial - xdg_shell_view->configure_serial) >= 0) {
+		xdg_shell_view->configure_acked = true;
+	}
+}
+
 static void
 handle_xdg_shell_surface_commit(struct wl_listener *listener, void *_data) {
 	struct cg_xdg_shell_view *xdg_shell_view =
 	    wl_container_of(listener, xdg_shell_view, commit);
 	struct cg_view *view = &xdg_shell_view->view;
-	view_damage_part(view);
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(view->server);
+	latency_commit(view->server);
+	/* The client committed the acked size, send the latest one if it changed
+	 * in the meantime */
+	if(xdg_shell_view->configure_acked) {
+		xdg_shell_view->configure_serial = 0;
+		xdg_shell_view->configure_acked = false;
+		if(xdg_shell_view->resize_pending) {
+			xdg_shell_view->resize_pending = false;
+			configure_size(xdg_shell_view, xdg_shell_view->pending_width,
+			               xdg_shell_view->pending_height);
+		}
+	}
+	view_damage_commit(view);
+	watchdog_end(view->server, CG_WATCHDOG_COMMIT, watchdog_start);
+	TRACE_END(trace_start, "xdg.commit");
 }
 
 static void
@@ -257,6 +330,10 @@ handle_xdg_shell_surface_unmap(struct wl_listener *listener, void *_data) {
 
 	wl_list_remove(&xdg_shell_view->new_popup.link);
 	wl_list_remove(&xdg_shell_view->commit.link);
+	wl_list_remove(&xdg_shell_view->ack_configure.link);
+	xdg_shell_view->configure_serial = 0;
+	xdg_shell_view->configure_acked = false;
+	xdg_shell_view->resize_pending = false;
 
 	view_unmap(view);
 }
@@ -266,10 +343,15 @@ handle_xdg_shell_surface_map(struct wl_listener *listener, void *_data) {
 	struct cg_xdg_shell_view *xdg_shell_view =
 	    wl_container_of(listener, xdg_shell_view, map);
 	struct cg_view *view = &xdg_shell_view->view;
+	uint64_t watchdog_start = watchdog_begin(view->server);
 
 	xdg_shell_view->commit.notify = handle_xdg_shell_surface_commit;
 	wl_signal_add(&xdg_shell_view->xdg_surface->surface->events.commit,
 	              &xdg_shell_view->commit);
+	xdg_shell_view->ack_configure.notify =
+	    handle_xdg_shell_surface_ack_configure;
+	wl_signal_add(&xdg_shell_view->xdg_surface->events.ack_configure,
+	              &xdg_shell_view->ack_configure);
 	xdg_shell_view->new_popup.notify = handle_new_xdg_popup;
 	wl_signal_add(&xdg_shell_view->xdg_surface->events.new_popup,
 	              &xdg_shell_view->new_popup);
@@ -278,6 +360,7 @@ handle_xdg_shell_surface_map(struct wl_listener *listener, void *_data) {
 	         view->server->curr_output
 	             ->workspaces[view->server->curr_output->curr_workspace]);
 	view_damage_whole(view);
+	watchdog_end(view->server, CG_WATCHDOG_MAP, watchdog_start);
 }
 
 static void
@@ -297,6 +380,7 @@ handle_xdg_shell_surface_destroy(struct wl_listener *listener, void *_data) {
 
 static const struct cg_view_impl xdg_shell_view_impl = {
     .get_title = get_title,
+    .get_app_id = get_app_id,
     .is_primary = is_primary,
     .activate = activate,
     .close = close,
@@ -11,8 +11,17 @@ struct cg_xdg_shell_view {
 	struct wl_listener unmap;
 	struct wl_listener map;
 	struct wl_listener commit;
+	struct wl_listener ack_configure;
 	struct wl_listener request_fullscreen;
 	struct wl_listener new_popup;
+
+	/* Only one resize is sent at a time. Sizes requested while the client
+	 * has not yet acked and committed it are coalesced into the next one. */
+	uint32_t configure_serial; // 0 if no resize is in flight
+	bool configure_acked;
+	int configure_width, configure_height;
+	bool resize_pending;
+	int pending_width, pending_height;
 };
 
 struct cg_xdg_popup {
@@ -6,22 +6,32 @@
  *
  * See the LICENSE file accompanying this file.
  */
+
+#define _POSIX_C_SOURCE 200809L
+
 #include "config.h"
 
 #include <X11/Xutil.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_output_damage.h>
 #include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #if CG_HAS_XWAYLAND
 #include <wlr/xwayland.h>
 #endif
 
+#include "latency.h"
 #include "output.h"
+#include "seat.h"
 #include "server.h"
+#include "trace.h"
 #include "view.h"
+#include "watchdog.h"
 #include "workspace.h"
 #include "xwayland.h"
 
@@ -39,9 +49,7 @@ bool
 xwayland_view_should_manage(const struct cg_view *view) {
 	const struct cg_xwayland_view *xwayland_view =
 	    xwayland_view_from_const_view(view);
-	struct wlr_xwayland_surface *xwayland_surface =
-	    xwayland_view->xwayland_surface;
-	return !xwayland_surface->override_redirect;
+	return !xwayland_view->override_redirect;
 }
 
 static char *
@@ -51,6 +59,13 @@ get_title(const struct cg_view *view) {
 	return xwayland_view->xwayland_surface->title;
 }
 
+static char *
+get_app_id(const struct cg_view *view) {
+	const struct cg_xwayland_view *xwayland_view =
+	    xwayland_view_from_const_view(view);
+	return xwayland_view->xwayland_surface->class;
+}
+
 static bool
 is_primary(const struct cg_view *view) {
 	const struct cg_xwayland_view *xwayland_view =
@@ -136,11 +151,23 @@ handle_xwayland_surface_request_fullscreen(struct wl_listener *listener,
 	                                    xwayland_surface->fullscreen);
 }
 
+static void
+handle_xwayland_surface_set_override_redirect(struct wl_listener *listener,
+                                              void *_data) {
+	struct cg_xwayland_view *xwayland_view =
+	    wl_container_of(listener, xwayland_view, set_override_redirect);
+	xwayland_view->override_redirect =
+	    xwayland_view->xwayland_surface->override_redirect;
+}
+
 static void
 handle_xwayland_surface_commit(struct wl_listener *listener, void *_data) {
 	struct cg_xwayland_view *xwayland_view =
 	    wl_container_of(listener, xwayland_view, commit);
 	struct cg_view *view = &xwayland_view->view;
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(view->server);
+	latency_commit(view->server);
 	/* xwayland surface has moved */
 	if(xwayland_view->xwayland_surface->x != view->ox ||
 	   xwayland_view->xwayland_surface->y != view->oy) {
@@ -151,8 +178,13 @@ handle_xwayland_surface_commit(struct wl_listener *listener, void *_data) {
 		output_damage_surface(view->workspace->output, view->wlr_surface,
 		                      view->ox, view->oy, true);
 	} else {
-		view_damage_part(view);
+		view_damage_commit(view);
 	}
+	if(xwayland_view->override_redirect) {
+		workspace_update_unmanaged_box(view->workspace);
+	}
+	watchdog_end(view->server, CG_WATCHDOG_COMMIT, watchdog_start);
+	TRACE_END(trace_start, "xwayland.commit");
 }
 
 static void
@@ -171,7 +203,11 @@ handle_xwayland_surface_map(struct wl_listener *listener, void *_data) {
 	struct cg_xwayland_view *xwayland_view =
 	    wl_container_of(listener, xwayland_view, map);
 	struct cg_view *view = &xwayland_view->view;
+	TRACE_BEGIN(trace_start);
+	uint64_t watchdog_start = watchdog_begin(view->server);
 
+	xwayland_view->override_redirect =
+	    xwayland_view->xwayland_surface->override_redirect;
 	if(!xwayland_view_should_manage(view)) {
 		view->ox = xwayland_view->xwayland_surface->x;
 		view->oy = xwayland_view->xwayland_surface->y;
@@ -186,6 +222,8 @@ handle_xwayland_surface_map(struct wl_listener *listener, void *_data) {
 	             ->workspaces[view->server->curr_output->curr_workspace]);
 
 	view_damage_whole(view);
+	watchdog_end(view->server, CG_WATCHDOG_MAP, watchdog_start);
+	TRACE_END(trace_start, "xwayland.map");
 }
 
 static void
@@ -198,13 +236,21 @@ handle_xwayland_surface_destroy(struct wl_listener *listener, void *_data) {
 	wl_list_remove(&xwayland_view->unmap.link);
 	wl_list_remove(&xwayland_view->destroy.link);
 	wl_list_remove(&xwayland_view->request_fullscreen.link);
+	wl_list_remove(&xwayland_view->set_override_redirect.link);
 	xwayland_view->xwayland_surface = NULL;
 
+	struct cg_server *server = view->server;
 	view_destroy(view);
+
+	if(--server->xwayland_surfaces == 0 && server->xwayland_idle_timeout > 0) {
+		wl_event_source_timer_update(server->xwayland_idle,
+		                             server->xwayland_idle_timeout * 1000);
+	}
 }
 
 static const struct cg_view_impl xwayland_view_impl = {
     .get_title = get_title,
+    .get_app_id = get_app_id,
     .is_primary = is_primary,
     .activate = activate,
     .close = close,
@@ -232,6 +278,11 @@ handle_xwayland_surface_new(struct wl_listener *listener, void *data) {
 	view_init(&xwayland_view->view, CG_XWAYLAND_VIEW, &xwayland_view_impl,
 	          server);
 	xwayland_view->xwayland_surface = xwayland_surface;
+	xwayland_view->override_redirect = xwayland_surface->override_redirect;
+
+	if(server->xwayland_surfaces++ == 0) {
+		wl_event_source_timer_update(server->xwayland_idle, 0);
+	}
 
 	xwayland_view->map.notify = handle_xwayland_surface_map;
 	wl_signal_add(&xwayland_surface->events.map, &xwayland_view->map);
@@ -243,4 +294,127 @@ handle_xwayland_surface_new(struct wl_listener *listener, void *data) {
 	    handle_xwayland_surface_request_fullscreen;
 	wl_signal_add(&xwayland_surface->events.request_fullscreen,
 	              &xwayland_view->request_fullscreen);
+	xwayland_view->set_override_redirect.notify =
+	    handle_xwayland_surface_set_override_redirect;
+	wl_signal_add(&xwayland_surface->events.set_override_redirect,
+	              &xwayland_view->set_override_redirect);
+}
+
+/* The cursor theme is only needed once an X server is running, so it is loaded
+ * when XWayland is ready and freed again once the cursor has been copied. */
+static void
+handle_xwayland_ready(struct wl_listener *listener, void *_data) {
+	struct cg_server *server =
+	    wl_container_of(listener, server, xwayland_ready);
+
+	server->xwayland_running = true;
+	wlr_xwayland_set_seat(server->xwayland, server->seat->seat);
+	/* Clients such as xrdb or xset never open a window, X is shut down after
+	 * them as well */
+	if(server->xwayland_surfaces == 0 && server->xwayland_idle_timeout > 0) {
+		wl_event_source_timer_update(server->xwayland_idle,
+		                             server->xwayland_idle_timeout * 1000);
+	}
+
+	struct wlr_xcursor_manager *xcursor_manager =
+	    wlr_xcursor_manager_create(DEFAULT_XCURSOR, XCURSOR_SIZE);
+	if(!xcursor_manager) {
+		wlr_log(WLR_ERROR, "Cannot create XWayland XCursor manager");
+		return;
+	}
+	if(!wlr_xcursor_manager_load(xcursor_manager, 1)) {
+		wlr_log(WLR_ERROR, "Cannot load XWayland XCursor theme");
+	}
+	struct wlr_xcursor *xcursor =
+	    wlr_xcursor_manager_get_xcursor(xcursor_manager, DEFAULT_XCURSOR, 1);
+	if(xcursor) {
+		struct wlr_xcursor_image *image = xcursor->images[0];
+		wlr_xwayland_set_cursor(server->xwayland, image->buffer,
+		                        image->width * 4, image->width, image->height,
+		                        image->hotspot_x, image->hotspot_y);
+	}
+	wlr_xcursor_manager_destroy(xcursor_manager);
+}
+
+/* Creates the XWayland socket, the X server itself is only started once the
+ * first client connects to it. */
+static int
+xwayland_start(struct cg_server *server) {
+	server->xwayland =
+	    wlr_xwayland_create(server->wl_display, server->compositor, true);
+	if(!server->xwayland) {
+		wlr_log(WLR_ERROR, "Cannot create XWayland server");
+		return -1;
+	}
+	server->new_xwayland_surface.notify = handle_xwayland_surface_new;
+	wl_signal_add(&server->xwayland->events.new_surface,
+	              &server->new_xwayland_surface);
+	server->xwayland_ready.notify = handle_xwayland_ready;
+	wl_signal_add(&server->xwayland->events.ready, &server->xwayland_ready);
+
+	const char *display = getenv("DISPLAY");
+	if(display != NULL && strcmp(display, server->xwayland->display_name) == 0) {
+		return 0;
+	}
+	if(setenv("DISPLAY", server->xwayland->display_name, true) < 0) {
+		wlr_log_errno(WLR_ERROR, "Unable to set DISPLAY for XWayland.",
+		              "Clients may not be able to connect");
+	} else {
+		wlr_log(WLR_DEBUG, "XWayland is listening on display %s",
+		        server->xwayland->display_name);
+	}
+	return 0;
+}
+
+static void
+xwayland_stop(struct cg_server *server) {
+	if(server->xwayland == NULL) {
+		return;
+	}
+	wl_list_remove(&server->new_xwayland_surface.link);
+	wl_list_remove(&server->xwayland_ready.link);
+	wlr_xwayland_destroy(server->xwayland);
+	server->xwayland = NULL;
+	server->xwayland_running = false;
+}
+
+/* No X window has been open for xwayland_idle_timeout seconds, shut the X
+ * server down and wait for the next client to start it again. Windows stand
+ * in for X clients, which wlroots does not let us count: the connections are
+ * made to the X server, and the window manager keeps one open itself. */
+static int
+handle_xwayland_idle(void *data) {
+	struct cg_server *server = data;
+	if(server->xwayland_surfaces > 0 || !server->xwayland_running) {
+		return 0;
+	}
+	wlr_log(WLR_DEBUG, "Shutting down idle XWayland server");
+	xwayland_stop(server);
+	if(xwayland_start(server) != 0) {
+		wlr_log(WLR_ERROR, "X11 clients can no longer be started");
+	}
+	return 0;
+}
+
+int
+xwayland_init(struct cg_server *server, struct wlr_compositor *compositor) {
+	server->compositor = compositor;
+	server->xwayland_surfaces = 0;
+	server->xwayland_running = false;
+	server->xwayland_idle =
+	    wl_event_loop_add_timer(server->event_loop, handle_xwayland_idle, server);
+	if(!server->xwayland_idle) {
+		wlr_log(WLR_ERROR, "Cannot create XWayland idle timer");
+		return -1;
+	}
+	return xwayland_start(server);
+}
+
+void
+xwayland_fini(struct cg_server *server) {
+	xwayland_stop(server);
+	if(server->xwayland_idle != NULL) {
+		wl_event_source_remove(server->xwayland_idle);
+		server->xwayland_idle = NULL;
+	}
 }
@@ -3,6 +3,9 @@
 
 #include "view.h"
 
+struct cg_server;
+struct wlr_compositor;
+
 struct cg_xwayland_view {
 	struct cg_view view;
 	struct wlr_xwayland_surface *xwayland_surface;
@@ -12,6 +15,10 @@ struct cg_xwayland_view {
 	struct wl_listener map;
 	struct wl_listener commit;
 	struct wl_listener request_fullscreen;
+	struct wl_listener set_override_redirect;
+
+	/* Cached from xwayland_surface, which only changes it before a map */
+	bool override_redirect;
 };
 
 struct cg_xwayland_view *
@@ -20,5 +27,9 @@ bool
 xwayland_view_should_manage(const struct cg_view *view);
 void
 handle_xwayland_surface_new(struct wl_listener *listener, void *data);
+int
+xwayland_init(struct cg_server *server, struct wlr_compositor *compositor);
+void
+xwayland_fini(struct cg_server *server);
 
 #endif